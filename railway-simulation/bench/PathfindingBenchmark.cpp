@@ -0,0 +1,162 @@
+#include "../incl/RailwayNetwork.hpp"
+#include "../incl/DijkstraPathfinding.hpp"
+#include "../incl/AltPathfinding.hpp"
+#include "../incl/ContractionHierarchyPathfinding.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+/*
+ * Pathfinding benchmark on generated networks
+ *
+ * Usage: ./PathfindingBenchmark [nodes] [queries] [landmarks]
+ *
+ * Builds a grid-like network (every 10th node is a city, plus a few long
+ * cross-country lines), then runs the same random OD pairs through each
+ * strategy and reports settled nodes, query latency and route mismatches.
+ * The contraction hierarchy is queried after a saveToFile()/loadFromFile()
+ * round trip through a file in the current directory, and must give the
+ * same routes as the hierarchy it was saved from.
+ */
+
+static const char* CH_FILE = "PathfindingBenchmark.ch";
+
+static RailwayNetwork* generateNetwork(int nodeCount) {
+    RailwayNetwork* network = new RailwayNetwork();
+    std::vector<std::string> names;
+
+    for (int i = 0; i < nodeCount; ++i) {
+        std::ostringstream oss;
+        oss << (i % 10 == 0 ? "City" : "RailNode") << i;
+        names.push_back(oss.str());
+        network->addNode(oss.str());
+    }
+
+    int width = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(nodeCount))));
+    for (int i = 0; i < nodeCount; ++i) {
+        if ((i + 1) % width != 0 && i + 1 < nodeCount) {
+            network->addRail(names[i], names[i + 1],
+                             1.0 + rand() % 20, 100.0 + rand() % 200);
+        }
+        if (i + width < nodeCount) {
+            network->addRail(names[i], names[i + width],
+                             1.0 + rand() % 20, 100.0 + rand() % 200);
+        }
+        if (rand() % 200 == 0) {
+            int other = rand() % nodeCount;
+            if (other != i) {
+                network->addRail(names[i], names[other],
+                                 20.0 + rand() % 80, 200.0 + rand() % 100);
+            }
+        }
+    }
+    return network;
+}
+
+static double routeCost(const std::vector<Node*>& path) {
+    double cost = 0.0;
+    for (size_t i = 0; i + 1 < path.size(); ++i) {
+        cost += DijkstraPathfinding::calculateCost(path[i]->getRailTo(path[i + 1]));
+    }
+    return cost;
+}
+
+static double elapsedMs(clock_t from, clock_t to) {
+    return 1000.0 * static_cast<double>(to - from) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv) {
+    int nodeCount = (argc > 1) ? atoi(argv[1]) : 100000;
+    int queryCount = (argc > 2) ? atoi(argv[2]) : 200;
+    int landmarkCount = (argc > 3) ? atoi(argv[3]) : 8;
+
+    srand(42);
+    RailwayNetwork* network = generateNetwork(nodeCount);
+    const std::vector<Node*>& nodes = network->getNodes();
+    std::cout << "Network: " << network->getNodeCount() << " nodes, "
+              << network->getRailCount() << " rails" << std::endl;
+
+    DijkstraPathfinding dijkstra(network);
+    DijkstraPathfinding bidirectional(network, SEARCH_BIDIRECTIONAL);
+    AltPathfinding alt;
+
+    clock_t begin = clock();
+    alt.preprocess(*network, landmarkCount);
+    std::cout << "ALT preprocessing (" << alt.getLandmarks().size()
+              << " landmarks): " << elapsedMs(begin, clock()) << " ms" << std::endl;
+
+    ContractionHierarchyPathfinding built;
+    begin = clock();
+    built.preprocess(*network);
+    std::cout << "CH preprocessing (" << built.getShortcutCount()
+              << " shortcuts): " << elapsedMs(begin, clock()) << " ms" << std::endl;
+
+    ContractionHierarchyPathfinding ch;
+    begin = clock();
+    bool roundTrip = built.saveToFile(CH_FILE) && ch.loadFromFile(CH_FILE, *network) &&
+                     ch.getShortcutCount() == built.getShortcutCount();
+    std::remove(CH_FILE);
+    std::cout << "CH save and load: " << elapsedMs(begin, clock()) << " ms"
+              << (roundTrip ? "" : "  <-- FAILED") << std::endl;
+    if (!roundTrip) {
+        delete network;
+        return 1;
+    }
+
+    double dijkstraMs = 0.0, bidirectionalMs = 0.0, altMs = 0.0, chMs = 0.0;
+    double dijkstraSettled = 0.0, bidirectionalSettled = 0.0, altSettled = 0.0;
+    int mismatches = 0;
+
+    for (int q = 0; q < queryCount; ++q) {
+        Node* from = nodes[rand() % nodes.size()];
+        Node* to = nodes[rand() % nodes.size()];
+
+        clock_t t0 = clock();
+        std::vector<Node*> reference = dijkstra.findPath(from, to);
+        clock_t t1 = clock();
+        std::vector<Node*> both = bidirectional.findPath(from, to);
+        clock_t t2 = clock();
+        std::vector<Node*> path = alt.findPath(from, to);
+        clock_t t3 = clock();
+        std::vector<Node*> contracted = ch.findPath(from, to);
+        clock_t t4 = clock();
+
+        dijkstraMs += elapsedMs(t0, t1);
+        bidirectionalMs += elapsedMs(t1, t2);
+        altMs += elapsedMs(t2, t3);
+        chMs += elapsedMs(t3, t4);
+        dijkstraSettled += dijkstra.getSettledCount();
+        bidirectionalSettled += bidirectional.getSettledCount();
+        altSettled += alt.getSettledCount();
+
+        if (reference.empty() != path.empty() ||
+            reference.empty() != both.empty() ||
+            reference.empty() != contracted.empty() ||
+            std::fabs(routeCost(reference) - routeCost(path)) > 1e-9 ||
+            std::fabs(routeCost(reference) - routeCost(both)) > 1e-9 ||
+            std::fabs(routeCost(reference) - routeCost(contracted)) > 1e-9 ||
+            contracted != built.findPath(from, to)) {
+            mismatches++;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "\nStrategy    avg settled    avg query (ms)\n"
+              << "Dijkstra    " << std::setw(11) << dijkstraSettled / queryCount
+              << "    " << std::setw(14) << dijkstraMs / queryCount << "\n"
+              << "Bidirect.   " << std::setw(11) << bidirectionalSettled / queryCount
+              << "    " << std::setw(14) << bidirectionalMs / queryCount << "\n"
+              << "ALT         " << std::setw(11) << altSettled / queryCount
+              << "    " << std::setw(14) << altMs / queryCount << "\n"
+              << "CH (loaded) " << std::setw(11) << "-"
+              << "    " << std::setw(14) << chMs / queryCount << "\n"
+              << "\nRoute cost mismatches: " << mismatches
+              << " / " << queryCount << std::endl;
+
+    delete network;
+    return mismatches == 0 ? 0 : 1;
+}
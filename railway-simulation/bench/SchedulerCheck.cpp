@@ -0,0 +1,107 @@
+#include "../incl/EventScheduler.hpp"
+#include "../incl/EventFactory.hpp"
+#include "../incl/RailwayNetwork.hpp"
+#include "../incl/Rail.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Ordering check of EventScheduler entries due at the same time
+ *
+ * Usage: ./SchedulerCheck
+ *
+ * Schedules windows that touch or close when they open, runs them and
+ * compares the order of execute(), expire() and deletion with the
+ * expected one. A window that closes when it opens must run its start
+ * before its end, also after a save()/restore() round trip, and its event
+ * must be deleted only after both.
+ */
+
+class RecordingEvent : public IEvent {
+private:
+    std::string _name;
+    std::vector<std::string>& _log;
+
+public:
+    RecordingEvent(const std::string& name, std::vector<std::string>& log)
+        : _name(name), _log(log) {}
+    virtual ~RecordingEvent() { _log.push_back("delete " + _name); }
+
+    virtual void execute() { _log.push_back("execute " + _name); }
+    virtual void expire() { _log.push_back("expire " + _name); }
+    virtual std::string getDescription() const { return _name; }
+};
+
+static bool expect(const std::string& name, const std::vector<std::string>& log,
+                   const char* const* expected, size_t count) {
+    bool ok = (log.size() == count);
+    for (size_t i = 0; ok && i < count; ++i) {
+        ok = (log[i] == expected[i]);
+    }
+
+    std::cout << name << ":";
+    for (size_t i = 0; i < log.size(); ++i) {
+        std::cout << (i ? ", " : " ") << log[i];
+    }
+    std::cout << (ok ? "" : "  <-- WRONG ORDER") << std::endl;
+    return ok;
+}
+
+int main() {
+    int failures = 0;
+    const Tick t0 = 10 * TICKS_PER_MINUTE;
+    const Tick t1 = 20 * TICKS_PER_MINUTE;
+
+    // A window that closes when it opens
+    {
+        std::vector<std::string> log;
+        EventScheduler scheduler;
+        scheduler.schedule(new RecordingEvent("A", log), t0, t0);
+        scheduler.processUntil(t0, NULL);
+        const char* expected[] = { "execute A", "expire A", "delete A" };
+        failures += expect("empty window", log, expected, 3) ? 0 : 1;
+    }
+
+    // Back-to-back windows, and an empty one at the boundary
+    {
+        std::vector<std::string> log;
+        EventScheduler scheduler;
+        scheduler.schedule(new RecordingEvent("B", log), t0, t1);
+        scheduler.schedule(new RecordingEvent("C", log), t1, t1);
+        scheduler.schedule(new RecordingEvent("D", log), t1, t1 + TICKS_PER_MINUTE);
+        scheduler.processUntil(t1 + TICKS_PER_MINUTE, NULL);
+        const char* expected[] = { "execute B", "expire B", "delete B",
+                                   "execute C", "expire C", "delete C",
+                                   "execute D", "expire D", "delete D" };
+        failures += expect("touching windows", log, expected, 9) ? 0 : 1;
+    }
+
+    // The same empty window through a checkpoint: the restriction is lifted
+    {
+        RailwayNetwork network;
+        network.addNode("A");
+        network.addNode("B");
+        Rail* rail = network.addRail("A", "B", 10.0, 200.0);
+        std::vector<Train*> trains;
+
+        EventScheduler scheduler;
+        scheduler.schedule(new SpeedReductionEvent(rail, 50.0, &network), t0, t0);
+        std::stringstream buffer;
+        EventScheduler restored;
+        bool ok = scheduler.save(buffer) && restored.restore(buffer, &network, trains);
+        if (ok) {
+            restored.processUntil(t0, NULL);
+        }
+        ok = ok && rail->getSpeedLimit() == rail->getNominalSpeedLimit();
+        std::cout << "empty window after restore: speed limit " << rail->getSpeedLimit()
+                  << " of " << rail->getNominalSpeedLimit()
+                  << (ok ? "" : "  <-- NOT RESTORED") << std::endl;
+        failures += ok ? 0 : 1;
+    }
+
+    std::cout << (failures == 0 ? "OK" : "FAILED") << ": " << failures
+              << " of 3 cases" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include "../incl/SimulationManager.hpp"
+#include "../incl/InputParser.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/*
+ * Consistency check between fixed stepping and the other stepping modes
+ *
+ * Usage: ./SteppingCheck [network] [trains] [events|-] [step minutes]
+ *
+ * Runs the same scenario with STEPPING_FIXED as the reference and with every
+ * variant below, and compares the arrival clock of every train. The check
+ * fails when a train arrives in only one of two runs or when the arrivals
+ * differ by more than the variant's tolerance, in time steps. The
+ * event-driven engine keeps exact times, while the fixed step stamps an
+ * arrival with the start of its step and moves each step at the speed
+ * reached at its end, so it is allowed one step more; so is the adaptive
+ * step, whose steps start at the given step and grow up to an hour.
+ */
+
+struct Variant {
+    const char* name;
+    SteppingMode mode;
+    bool adaptive;
+    int tolerance;      // Time steps
+};
+
+static const Variant VARIANTS[] = {
+    { "analytic", STEPPING_ANALYTIC, false, 1 },
+    { "event-driven", STEPPING_EVENT_DRIVEN, false, 2 },
+    { "adaptive", STEPPING_FIXED, true, 2 }
+};
+static const size_t VARIANT_COUNT = sizeof(VARIANTS) / sizeof(VARIANTS[0]);
+
+static SimulationManager* runScenario(const RailwayNetwork& network,
+                                      const std::vector<Train*>& trains,
+                                      const std::string& eventsFile,
+                                      SteppingMode mode, bool adaptive, int stepMinutes) {
+    SimulationManager* manager = new SimulationManager();
+    manager->loadScenario(network, trains);
+    manager->setSteppingMode(mode);
+    manager->setTimeStepMinutes(stepMinutes);
+    if (adaptive) {
+        manager->setStepBounds(stepMinutes * TICKS_PER_MINUTE, TICKS_PER_HOUR);
+        manager->setAdaptiveStep(true);
+    }
+
+    if (eventsFile != "-") {
+        std::vector<ScheduledEvent> events = InputParser::parseEventsFile(
+            eventsFile, manager->getNetwork(), manager->getTrains());
+        for (size_t i = 0; i < events.size(); ++i) {
+            manager->scheduleEvent(events[i].event, events[i].start, events[i].end);
+        }
+        manager->setRerouting(true);
+    }
+
+    manager->initialize();
+    manager->run();
+    return manager;
+}
+
+int main(int argc, char** argv) {
+    std::string networkFile = (argc > 1) ? argv[1] : "examples/network.txt";
+    std::string trainsFile = (argc > 2) ? argv[2] : "examples/trains.txt";
+    std::string eventsFile = (argc > 3) ? argv[3] : "-";
+    int stepMinutes = (argc > 4) ? atoi(argv[4]) : 1;
+
+    if (stepMinutes <= 0) {
+        std::cerr << "Error: step must be a positive number of minutes" << std::endl;
+        return 2;
+    }
+
+    Tick step = stepMinutes * TICKS_PER_MINUTE;
+    RailwayNetwork* network = NULL;
+    std::vector<Train*> trains;
+    try {
+        network = InputParser::parseNetworkFile(networkFile);
+        trains = InputParser::parseTrainsFile(trainsFile, network);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        delete network;
+        return 2;
+    }
+
+    SimulationManager* fixed = runScenario(*network, trains, eventsFile,
+                                           STEPPING_FIXED, false, stepMinutes);
+    std::vector<SimulationManager*> runs;
+    for (size_t v = 0; v < VARIANT_COUNT; ++v) {
+        runs.push_back(runScenario(*network, trains, eventsFile,
+                                   VARIANTS[v].mode, VARIANTS[v].adaptive, stepMinutes));
+    }
+
+    const std::vector<Train*>& fixedTrains = fixed->getTrains();
+    int failures = 0;
+
+    for (size_t i = 0; i < fixedTrains.size(); ++i) {
+        const Train* a = fixedTrains[i];
+        std::cout << a->getName() << ": fixed "
+                  << (a->hasArrived() ? formatClock(a->getCurrentTime()) : "not arrived");
+
+        bool ok = a->hasArrived();
+        for (size_t v = 0; v < runs.size(); ++v) {
+            const Train* b = runs[v]->getTrains()[i];
+            std::cout << ", " << VARIANTS[v].name << " "
+                      << (b->hasArrived() ? formatClock(b->getCurrentTime()) : "not arrived");
+
+            Tick gap = a->getCurrentTime() - b->getCurrentTime();
+            Tick tolerance = VARIANTS[v].tolerance * step;
+            ok = ok && b->hasArrived() && gap <= tolerance && -gap <= tolerance;
+        }
+        if (!ok) {
+            ++failures;
+        }
+        std::cout << (ok ? "" : "  <-- MISMATCH") << std::endl;
+    }
+
+    std::cout << (failures == 0 ? "OK" : "FAILED") << ": " << failures << " of "
+              << fixedTrains.size() << " trains outside tolerance (step "
+              << stepMinutes << " min)" << std::endl;
+
+    delete fixed;
+    for (size_t v = 0; v < runs.size(); ++v) {
+        delete runs[v];
+    }
+    for (size_t i = 0; i < trains.size(); ++i) {
+        delete trains[i];
+    }
+    delete network;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include "../incl/SimulationManager.hpp"
+#include "../incl/InputParser.hpp"
+#include "../incl/OutputWriter.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+ * Consistency check between whole-trace and streamed result files
+ *
+ * Usage: ./StreamingCheck [network] [trains] [events|-] [window]
+ *
+ * Runs the same scenario twice, once keeping every trace record and once
+ * streaming them in windows of `window` records, and compares the result
+ * files line by line. Only the trailing padding of the streamed travel
+ * time may differ. The files are written to the current directory and
+ * removed afterwards.
+ */
+
+struct RunOutput {
+    std::vector<std::string> files;     // Contents, in train order
+    size_t traceMemory;                 // Largest getTraceMemory() of a writer
+};
+
+static std::string readAndRemove(const std::string& filename) {
+    std::ifstream in(filename.c_str());
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    in.close();
+    std::remove(filename.c_str());
+    return contents.str();
+}
+
+static std::string trimLines(const std::string& text) {
+    std::istringstream in(text);
+    std::string line;
+    std::string trimmed;
+    while (std::getline(in, line)) {
+        line.erase(line.find_last_not_of(' ') + 1);
+        trimmed += line + "\n";
+    }
+    return trimmed;
+}
+
+static RunOutput runScenario(const RailwayNetwork& network, const std::vector<Train*>& trains,
+                             const std::string& eventsFile, size_t window) {
+    SimulationManager manager;
+    manager.loadScenario(network, trains);
+    manager.setTimeStepMinutes(1);
+
+    if (eventsFile != "-") {
+        std::vector<ScheduledEvent> events = InputParser::parseEventsFile(
+            eventsFile, manager.getNetwork(), manager.getTrains());
+        for (size_t i = 0; i < events.size(); ++i) {
+            manager.scheduleEvent(events[i].event, events[i].start, events[i].end);
+        }
+        manager.setRerouting(true);
+    }
+
+    const std::vector<Train*>& running = manager.getTrains();
+    std::vector<OutputWriter*> writers;
+    for (size_t i = 0; i < running.size(); ++i) {
+        OutputWriter* writer = new OutputWriter(running[i]);
+        writer->setStreaming(window);
+        writers.push_back(writer);
+        manager.addStepObserver(writer);
+    }
+
+    manager.initialize();
+    manager.run();
+
+    RunOutput output;
+    output.traceMemory = 0;
+    for (size_t i = 0; i < writers.size(); ++i) {
+        const Train* train = running[i];
+        if (train->hasArrived()) {
+            writers[i]->setEstimatedTime(train->getCurrentTime() - train->getDepartureTime());
+        }
+        output.traceMemory = std::max(output.traceMemory, writers[i]->getTraceMemory());
+        writers[i]->writeToFile();
+        output.files.push_back(readAndRemove(writers[i]->getFilename()));
+        delete writers[i];
+    }
+    return output;
+}
+
+int main(int argc, char** argv) {
+    std::string networkFile = (argc > 1) ? argv[1] : "examples/network.txt";
+    std::string trainsFile = (argc > 2) ? argv[2] : "examples/trains.txt";
+    std::string eventsFile = (argc > 3) ? argv[3] : "-";
+    int window = (argc > 4) ? atoi(argv[4]) : 7;
+
+    if (window <= 0) {
+        std::cerr << "Error: window must be a positive number of records" << std::endl;
+        return 2;
+    }
+
+    RailwayNetwork* network = NULL;
+    std::vector<Train*> trains;
+    try {
+        network = InputParser::parseNetworkFile(networkFile);
+        trains = InputParser::parseTrainsFile(trainsFile, network);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        delete network;
+        return 2;
+    }
+
+    RunOutput whole = runScenario(*network, trains, eventsFile, 0);
+    RunOutput streamed = runScenario(*network, trains, eventsFile, static_cast<size_t>(window));
+
+    int failures = 0;
+    for (size_t i = 0; i < trains.size(); ++i) {
+        bool ok = !whole.files[i].empty() &&
+                  trimLines(whole.files[i]) == trimLines(streamed.files[i]);
+        if (!ok) {
+            ++failures;
+        }
+        std::cout << trains[i]->getName() << ": " << whole.files[i].size() << " bytes"
+                  << (ok ? "" : "  <-- MISMATCH") << std::endl;
+    }
+
+    std::cout << "Trace memory per writer: " << whole.traceMemory << " bytes whole, "
+              << streamed.traceMemory << " bytes streamed (window " << window << ")"
+              << std::endl;
+    std::cout << (failures == 0 ? "OK" : "FAILED") << ": " << failures << " of "
+              << trains.size() << " result files differ" << std::endl;
+
+    for (size_t i = 0; i < trains.size(); ++i) {
+        delete trains[i];
+    }
+    delete network;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+#ifndef ALTPATHFINDING_HPP
+#define ALTPATHFINDING_HPP
+
+#include "IPathfindingStrategy.hpp"
+#include "RailwayNetwork.hpp"
+#include <vector>
+
+/**
+ * @class AltPathfinding
+ * @brief A* with Landmarks and the Triangle inequality (ALT)
+ *
+ * The network file has no coordinates, so the A* heuristic comes from
+ * precomputed travel-time distances to a few landmarks:
+ *   h(v) = max over landmarks L of |d(L, target) - d(L, v)|
+ * which never overestimates the remaining cost. Landmarks are picked among
+ * city nodes by farthest-point selection.
+ *
+ * Like ContractionHierarchyPathfinding, the tables are a snapshot of the
+ * network and must be rebuilt with preprocess() after it changes.
+ */
+class AltPathfinding : public IPathfindingStrategy {
+private:
+    const RailwayNetwork* _network;
+    std::vector<Node*> _nodes;              // Indexed by Node::getId()
+    std::vector<Node*> _landmarks;
+    std::vector<double> _landmarkDist;      // [landmark * nodeCount + node]
+
+    // Query scratch, indexed by Node::getId()
+    std::vector<double> _dist;
+    std::vector<double> _bound;             // Heuristic, cached per query
+    std::vector<Node*> _prev;
+    std::vector<unsigned int> _stamp;
+    unsigned int _query;
+    size_t _settled;
+
+public:
+    AltPathfinding();
+    virtual ~AltPathfinding();
+
+    /**
+     * @brief Select landmarks and compute their distance tables
+     * @param landmarkCount Number of landmarks (k), capped by node count
+     */
+    void preprocess(const RailwayNetwork& network, size_t landmarkCount);
+
+    const std::vector<Node*>& getLandmarks() const { return _landmarks; }
+    size_t getSettledCount() const { return _settled; }
+
+    virtual std::vector<Node*> findPath(Node* start, Node* end);
+    virtual IPathfindingStrategy* clone() const;
+
+private:
+    double heuristic(int node, int target) const;
+    double distanceOf(int id) const;
+};
+
+#endif // ALTPATHFINDING_HPP
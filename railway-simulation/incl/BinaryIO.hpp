@@ -0,0 +1,55 @@
+#ifndef BINARYIO_HPP
+#define BINARYIO_HPP
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Raw native-endian values for checkpoint files
+ *
+ * Doubles keep their exact bits, so a restored run continues bit for bit.
+ * Files are only meant to be read back by the same build on the same
+ * machine type.
+ */
+template <typename T>
+void writeBinary(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readBinary(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return in.good();
+}
+
+/**
+ * @brief Element count followed by the elements
+ */
+template <typename T>
+void writeBinaryVector(std::ostream& out, const std::vector<T>& values) {
+    unsigned long long count = values.size();
+    writeBinary(out, count);
+    if (!values.empty()) {
+        out.write(reinterpret_cast<const char*>(&values[0]), sizeof(T) * values.size());
+    }
+}
+
+/**
+ * @param limit Largest accepted count, so a corrupt file cannot ask for
+ *              an absurd allocation
+ */
+template <typename T>
+bool readBinaryVector(std::istream& in, std::vector<T>& values, unsigned long long limit) {
+    unsigned long long count = 0;
+    if (!readBinary(in, count) || count > limit) {
+        return false;
+    }
+    values.resize(static_cast<size_t>(count));
+    if (count > 0) {
+        in.read(reinterpret_cast<char*>(&values[0]), sizeof(T) * values.size());
+    }
+    return in.good();
+}
+
+#endif // BINARYIO_HPP
@@ -0,0 +1,76 @@
+#ifndef CACHEDPATHFINDING_HPP
+#define CACHEDPATHFINDING_HPP
+
+#include "IPathfindingStrategy.hpp"
+#include "INetworkListener.hpp"
+#include "RailwayNetwork.hpp"
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+ * @class CachedPathfinding
+ * @brief Decorator - Route cache in front of any IPathfindingStrategy
+ *
+ * Keeps one route per (origin, destination) pair, so trains sharing an
+ * OD pair trigger a single search. Listens to the network and drops:
+ * - routes crossing a rail whose speed limit was lowered
+ * - every route when a rail is added or a speed limit is raised
+ *   (either can open a faster route anywhere in the network)
+ */
+class CachedPathfinding : public IPathfindingStrategy, public INetworkListener {
+private:
+    typedef std::pair<int, int> RouteKey;   // (origin id, destination id)
+    
+    IPathfindingStrategy* _inner;           // Owned
+    RailwayNetwork* _network;
+    std::map<RouteKey, std::vector<Node*> > _routes;
+    std::map<const Rail*, std::set<RouteKey> > _routesByRail;
+    size_t _hits;
+    size_t _misses;
+    size_t _invalidations;
+    
+    // Prevent copying
+    CachedPathfinding(const CachedPathfinding&);
+    CachedPathfinding& operator=(const CachedPathfinding&);
+
+public:
+    /**
+     * @param inner Strategy computing routes on a miss (ownership taken)
+     * @param network Network to listen to for invalidation (may be NULL)
+     */
+    CachedPathfinding(IPathfindingStrategy* inner, RailwayNetwork* network);
+    virtual ~CachedPathfinding();
+    
+    virtual std::vector<Node*> findPath(Node* start, Node* end);
+    
+    /**
+     * @brief Cache of its own, empty, over a clone of the inner strategy
+     * @return NULL if the inner strategy cannot be cloned
+     */
+    virtual IPathfindingStrategy* clone() const;
+    
+    /**
+     * @brief Cached route for an OD pair, computed on first use
+     * @return Reference valid until the entry is invalidated
+     */
+    const std::vector<Node*>& getRoute(Node* start, Node* end);
+    
+    void clear();
+    
+    // Statistics
+    size_t getHitCount() const { return _hits; }
+    size_t getMissCount() const { return _misses; }
+    size_t getInvalidationCount() const { return _invalidations; }
+    size_t getCachedRouteCount() const { return _routes.size(); }
+    
+    // INetworkListener implementation
+    virtual void onRailAdded(Rail* rail);
+    virtual void onSpeedLimitChanged(Rail* rail, double oldSpeedLimit);
+    
+private:
+    void invalidateRail(const Rail* rail);
+    void dropRoute(const RouteKey& key);
+};
+
+#endif // CACHEDPATHFINDING_HPP
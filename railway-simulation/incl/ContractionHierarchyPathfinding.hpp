@@ -0,0 +1,99 @@
+#ifndef CONTRACTIONHIERARCHYPATHFINDING_HPP
+#define CONTRACTIONHIERARCHYPATHFINDING_HPP
+
+#include "IPathfindingStrategy.hpp"
+#include "RailwayNetwork.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * @class ContractionHierarchyPathfinding
+ * @brief Strategy using Contraction Hierarchies for fast point-to-point queries
+ *
+ * preprocess() contracts the network node by node (edge-difference order),
+ * adding shortcuts weighted with DijkstraPathfinding::calculateCost.
+ * findPath() then runs a bidirectional search restricted to upward edges
+ * and unpacks shortcuts back into the original node sequence.
+ *
+ * The hierarchy is a snapshot: it must be rebuilt (or reloaded) whenever
+ * the network changes. saveToFile()/loadFromFile() let the preprocessing
+ * be paid once per network version.
+ */
+class ContractionHierarchyPathfinding : public IPathfindingStrategy {
+private:
+    struct Edge {
+        int to;
+        double weight;
+        int middle;              // Contracted node of a shortcut, -1 if original
+
+        Edge(int t, double w, int m) : to(t), weight(w), middle(m) {}
+    };
+
+    std::vector<Node*> _nodes;                 // Indexed by Node::getId()
+    unsigned int _fingerprint;                 // Network version it was built for
+    std::vector<int> _rank;                    // Contraction order
+    std::vector<std::vector<Edge> > _upward;   // Edges towards higher rank
+
+    // Query scratch (index 0 = forward, 1 = backward)
+    std::vector<double> _dist[2];
+    std::vector<int> _parent[2];
+    std::vector<int> _parentMiddle[2];
+    std::vector<unsigned int> _stamp[2];
+    unsigned int _query;
+
+    // Witness search scratch used during preprocessing
+    std::vector<double> _witnessDist;
+    std::vector<unsigned int> _witnessStamp;
+    std::vector<unsigned int> _targetMark;
+    unsigned int _witnessQuery;
+
+public:
+    ContractionHierarchyPathfinding();
+    virtual ~ContractionHierarchyPathfinding();
+
+    /**
+     * @brief Build the hierarchy for the given network
+     */
+    void preprocess(const RailwayNetwork& network);
+
+    /**
+     * @brief Write the hierarchy to a binary file
+     * @return false if the file cannot be written
+     */
+    bool saveToFile(const std::string& filename) const;
+
+    /**
+     * @brief Load a hierarchy previously saved for this network
+     * @return false if the file is missing, corrupt or was built for
+     *         a different network
+     */
+    bool loadFromFile(const std::string& filename, const RailwayNetwork& network);
+
+    bool isReady() const { return !_rank.empty(); }
+    size_t getShortcutCount() const;
+
+    virtual std::vector<Node*> findPath(Node* start, Node* end);
+    virtual IPathfindingStrategy* clone() const;
+
+private:
+    // Preprocessing helpers
+    static void addOrImprove(std::vector<std::vector<Edge> >& graph,
+                             int from, int to, double weight, int middle);
+    int contract(std::vector<std::vector<Edge> >& graph,
+                 const std::vector<bool>& contracted, int node,
+                 bool simulate);
+    void witnessSearch(const std::vector<std::vector<Edge> >& graph,
+                       const std::vector<bool>& contracted,
+                       int source, int excluded, double limit,
+                       int settleLimit, int targets);
+    void nextWitnessQuery();
+    double witnessDistance(int id) const;
+
+    // Query helpers
+    void resetScratch();
+    double distanceOf(int side, int id) const;
+    int findMiddle(int a, int b) const;
+    void unpackEdge(int from, int to, int middle, std::vector<int>& out) const;
+};
+
+#endif // CONTRACTIONHIERARCHYPATHFINDING_HPP
@@ -0,0 +1,56 @@
+#ifndef CSRGRAPH_HPP
+#define CSRGRAPH_HPP
+
+#include <vector>
+
+class Node;
+class Rail;
+class RailwayNetwork;
+
+/**
+ * @class CsrGraph
+ * @brief Frozen compressed sparse row (CSR) view of a RailwayNetwork
+ *
+ * The rails leaving node v are the edges [getEdgeBegin(v), getEdgeEnd(v))
+ * of contiguous target / weight / rail arrays, in the same order as
+ * Node::getConnectedRails(). Weights are precomputed travel times
+ * (DijkstraPathfinding::calculateCost), so a traversal touches no Rail or
+ * Node objects. Indices are 32-bit Node::getId() / edge positions.
+ *
+ * RailwayNetwork::getGraph() keeps it up to date; a built graph is a
+ * snapshot and is not patched in place.
+ */
+class CsrGraph {
+public:
+    typedef unsigned int Index;
+
+private:
+    std::vector<Index> _offsets;     // nodeCount + 1 entries
+    std::vector<Index> _targets;
+    std::vector<double> _weights;
+    std::vector<Rail*> _rails;
+    std::vector<Node*> _nodes;
+
+public:
+    CsrGraph();
+    ~CsrGraph();
+
+    void build(const RailwayNetwork& network);
+
+    Index getNodeCount() const { return static_cast<Index>(_nodes.size()); }
+    Index getEdgeCount() const { return static_cast<Index>(_targets.size()); }
+    Node* getNode(Index node) const { return _nodes[node]; }
+
+    Index getEdgeBegin(Index node) const { return _offsets[node]; }
+    Index getEdgeEnd(Index node) const { return _offsets[node + 1]; }
+    Index getTarget(Index edge) const { return _targets[edge]; }
+    double getWeight(Index edge) const { return _weights[edge]; }
+    Rail* getRail(Index edge) const { return _rails[edge]; }
+
+    /**
+     * @brief Rail between two adjacent nodes (NULL if none)
+     */
+    Rail* findRail(Index from, Index to) const;
+};
+
+#endif // CSRGRAPH_HPP
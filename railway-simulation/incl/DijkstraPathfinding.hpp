@@ -2,23 +2,97 @@
 #define DIJKSTRAPATHFINDING_HPP
 
 #include "IPathfindingStrategy.hpp"
-#include <map>
+#include <functional>
+#include <queue>
+#include <vector>
+
+class RailwayNetwork;
+
+enum DijkstraSearchMode {
+    SEARCH_UNIDIRECTIONAL,
+    SEARCH_BIDIRECTIONAL
+};
 
 /**
  * @class DijkstraPathfinding
  * @brief Concrete implementation of pathfinding using Dijkstra's algorithm
  * 
  * Finds shortest path considering both distance and speed limits.
+ * Uses a binary heap with lazy deletion over dense node ids
+ * (Node::getId()), so a query runs in O((V + E) log V).
+ *
+ * SEARCH_BIDIRECTIONAL grows a second frontier backwards from the
+ * destination (rails are undirected) and stops once the two smallest
+ * keys add up to at least the best meeting distance. It needs no
+ * preprocessing, so it stays valid while the network is edited.
+ *
+ * Given the network, searches run over its CSR snapshot
+ * (RailwayNetwork::getGraph()); without it they walk the Node/Rail objects.
  */
 class DijkstraPathfinding : public IPathfindingStrategy {
 public:
-    DijkstraPathfinding();
+    explicit DijkstraPathfinding(const RailwayNetwork* network = NULL,
+                                 DijkstraSearchMode mode = SEARCH_UNIDIRECTIONAL);
     virtual ~DijkstraPathfinding();
     
     virtual std::vector<Node*> findPath(Node* start, Node* end);
+    virtual IPathfindingStrategy* clone() const;
+    
+    /**
+     * @brief One-to-all search from start
+     * @param nodeCount Size of the output arrays (RailwayNetwork::getNodeCount())
+     * @param distances Travel-time distance per node id (max() if unreachable)
+     * @param previous Predecessor per node id (NULL for start/unreachable)
+     */
+    void computeTree(Node* start, size_t nodeCount,
+                     std::vector<double>& distances,
+                     std::vector<Node*>& previous);
+    
+    /**
+     * @brief Number of nodes settled by the last query
+     */
+    size_t getSettledCount() const { return _settled; }
+    
+    DijkstraSearchMode getSearchMode() const { return _mode; }
+    void setSearchMode(DijkstraSearchMode mode) { _mode = mode; }
+    
+    /**
+     * @brief Travel-time weight of a rail (length / speed limit)
+     *
+     * Shared by the other strategies so every engine optimizes the same cost.
+     */
+    static double calculateCost(const Rail* rail);
     
 private:
-    double calculateCost(Rail* rail) const;
+    // Heap entries are (distance, node id); stale entries are skipped on pop
+    typedef std::pair<double, int> HeapEntry;
+    typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                                std::greater<HeapEntry> > MinHeap;
+    
+    const RailwayNetwork* _network;
+    DijkstraSearchMode _mode;
+    
+    // Per-node search scratch, indexed by Node::getId(). Entries are valid
+    // only when _stamp matches _query, so nothing is cleared between queries.
+    std::vector<double> _dist;
+    std::vector<Node*> _prev;
+    std::vector<Node*> _node;
+    std::vector<unsigned int> _stamp;
+    // Backward frontier of the bidirectional mode (_next points towards end)
+    std::vector<double> _distBack;
+    std::vector<Node*> _next;
+    std::vector<unsigned int> _stampBack;
+    unsigned int _query;
+    size_t _settled;
+    
+    void nextQuery();
+    bool search(Node* start, Node* end);
+    void relaxNeighbors(Node* current, double currentDist, int side,
+                        MinHeap& heap, double* best, Node** meeting);
+    std::vector<Node*> searchBidirectional(Node* start, Node* end);
+    void ensureCapacity(int id);
+    double distanceOf(int id) const;
+    double backDistanceOf(int id) const;
 };
 
 #endif // DIJKSTRAPATHFINDING_HPP
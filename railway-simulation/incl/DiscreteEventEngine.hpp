@@ -0,0 +1,151 @@
+#ifndef DISCRETEEVENTENGINE_HPP
+#define DISCRETEEVENTENGINE_HPP
+
+#include "Train.hpp"
+#include "IEvent.hpp"
+#include "EventScheduler.hpp"
+#include "ISubject.hpp"
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
+
+/**
+ * @class DiscreteEventEngine
+ * @brief Event-driven alternative to fixed time stepping
+ *
+ * Between two events every train moves with constant acceleration, so its
+ * position and speed follow in closed form. The engine keeps a priority
+ * queue of future events (departures, rail ends, reaching cruise speed,
+ * braking points before each rail end, the safety distance to the train
+ * ahead, scheduled IEvents) and jumps straight to the earliest one. The
+ * cost depends on the number of events, not on simulated minutes times
+ * trains.
+ *
+ * Motion follows the fixed-step rule of TrainStateStore in closed form, as
+ * KinematicProfile does: cruise at CRUISE_FRACTION of the limit, brake
+ * within BRAKING_ZONE of each rail end, and brake behind a train closer
+ * than SAFETY_DISTANCE.
+ *
+ * Trains are only brought up to date ("settled") when an event concerns
+ * them or a neighbour on the same rail needs their position. Each train has
+ * at most one pending motion event; re-planning bumps a version number so
+ * the old entry is skipped when popped.
+ *
+ * The interface uses Tick; internally times are minutes since the
+ * scenario epoch held in doubles, so closed-form roots keep full precision.
+ */
+class DiscreteEventEngine {
+private:
+    enum EventKind {
+        EVENT_DEPARTURE,
+        EVENT_RAIL_END,
+        EVENT_SPEED_REACHED,
+        EVENT_BRAKE_ONSET,
+        EVENT_HEADWAY,
+        EVENT_STOP,
+        EVENT_RESUME,            // End of a DelayEvent hold
+        EVENT_SCHEDULED
+    };
+
+    struct Event {
+        double time;             // Minutes
+        unsigned long sequence;  // Insertion order, breaks ties
+        EventKind kind;
+        size_t train;
+        unsigned int version;
+        IEvent* payload;         // EVENT_SCHEDULED only
+
+        bool operator>(const Event& other) const {
+            if (time != other.time) {
+                return time > other.time;
+            }
+            return sequence > other.sequence;
+        }
+    };
+
+    /**
+     * Motion of one train since its last settle: speed is read from the
+     * Train, acceleration (km/h per hour) is held here
+     */
+    struct Motion {
+        double time;
+        double accel;
+        unsigned int version;
+        bool active;             // Departed and not yet arrived
+    };
+
+    typedef std::priority_queue<Event, std::vector<Event>, std::greater<Event> > EventQueue;
+
+    std::vector<Train*> _trains;
+    std::vector<Motion> _motion;
+    std::map<const Train*, size_t> _indexOf;
+    EventQueue _queue;
+    unsigned long _sequence;
+    double _now;
+    size_t _processed;
+    ISubject* _subject;
+    EventScheduler* _scheduler;
+    std::vector<size_t> _affected;   // Trains the IEvent being run can change
+    bool _affectsAll;                // It names neither a train nor a rail
+    std::vector<size_t> _rerouted;   // Routes changed since the last re-plan
+
+public:
+    /**
+     * @param subject Receives arrival and scheduled-event notifications
+     *                (may be NULL)
+     */
+    DiscreteEventEngine(const std::vector<Train*>& trains, ISubject* subject);
+    ~DiscreteEventEngine();
+
+    /**
+     * @brief Queue an IEvent to run at the given time (takes ownership)
+     *
+     * After the event executes the trains it names are re-planned (its
+     * train, or every train on its rail), so events that change speed
+     * limits take effect immediately. An event naming neither re-plans
+     * every train.
+     */
+    void scheduleEvent(Tick time, IEvent* event);
+    
+    /**
+     * @brief Also run the entries of a timed scheduler, in time order with
+     *        the engine's own events (the scheduler stays with the caller)
+     */
+    void setScheduler(EventScheduler* scheduler) { _scheduler = scheduler; }
+
+    /**
+     * @brief Process events until every train has arrived or nothing is left
+     * @param start     Clock value when the run starts
+     * @param maxEvents Safety limit on processed events
+     * @return Time of the last processed event
+     */
+    Tick run(Tick start, size_t maxEvents);
+    
+    /**
+     * @brief A train's route was replaced while an event ran (re-routing);
+     *        it is re-planned with the event's trains
+     */
+    void routeChanged(const Train* train);
+
+    size_t getProcessedEventCount() const { return _processed; }
+
+    static const double SAFETY_DISTANCE;    // km, same headway as fixed stepping
+
+private:
+    void push(double time, EventKind kind, size_t train, IEvent* payload);
+    void replanAll();
+    void beforeEvent(const IEvent* event);
+    void afterEvent();
+    void settle(size_t index, double time);
+    void settleRail(const Rail* rail, double time);
+    void replan(size_t index);
+    void replanFollowers(size_t index);
+    size_t indexOf(const Train* train) const;
+    size_t findNeighbor(size_t index, bool ahead) const;
+    void arrive(size_t index);
+    static Tick toClock(double minute);
+    static double firstRoot(double a, double b, double c);
+};
+
+#endif // DISCRETEEVENTENGINE_HPP
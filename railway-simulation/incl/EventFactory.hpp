@@ -4,11 +4,19 @@
 #include "IEvent.hpp"
 #include "Train.hpp"
 #include "Rail.hpp"
+#include "RandomStream.hpp"
 #include <cstdlib>
+#include <istream>
+#include <vector>
+
+class RailwayNetwork;
 
 /**
  * @class DelayEvent
  * @brief Event that causes train delay
+ *
+ * Postpones the departure of a train still waiting at its origin, or
+ * holds a running train in place for the delay.
  */
 class DelayEvent : public IEvent {
 private:
@@ -20,23 +28,33 @@ public:
         : _train(train), _delayMinutes(delayMinutes) {}
     
     virtual void execute();
+    virtual bool save(std::ostream& out) const;
+    virtual Train* getTrain() const { return _train; }
     virtual std::string getDescription() const;
 };
 
 /**
  * @class SpeedReductionEvent
  * @brief Event that reduces speed limit on a rail
+ *
+ * Adds a temporary restriction that expire() lifts again; without an end
+ * time it stays for the rest of the run. With a network the change goes
+ * through RailwayNetwork so route caches and the CSR snapshot see it.
  */
 class SpeedReductionEvent : public IEvent {
 private:
     Rail* _rail;
     double _reductionPercent;
+    RailwayNetwork* _network;
     
 public:
-    SpeedReductionEvent(Rail* rail, double reductionPercent)
-        : _rail(rail), _reductionPercent(reductionPercent) {}
+    SpeedReductionEvent(Rail* rail, double reductionPercent, RailwayNetwork* network = NULL)
+        : _rail(rail), _reductionPercent(reductionPercent), _network(network) {}
     
     virtual void execute();
+    virtual void expire();
+    virtual bool save(std::ostream& out) const;
+    virtual Rail* getRail() const { return _rail; }
     virtual std::string getDescription() const;
 };
 
@@ -49,9 +67,31 @@ public:
  */
 class EventFactory {
 public:
+    /**
+     * @brief Delay a train by 5-25 min or slow a rail by 10-40%, or
+     *        nothing, with even odds
+     *
+     * Draws from a stream seeded with the global rand().
+     */
     static IEvent* createRandomEvent(Train* train);
     static IEvent* createRandomEvent(Rail* rail);
     
+    /**
+     * @brief Same distributions, drawn from a reproducible stream
+     */
+    static IEvent* createRandomEvent(Train* train, RandomStream& random);
+    static IEvent* createRandomEvent(Rail* rail, RandomStream& random,
+                                     RailwayNetwork* network = NULL);
+    
+    /**
+     * @brief Recreate an event written by IEvent::save()
+     *
+     * Trains are looked up by id (1-based position in @p trains), rails by
+     * id in @p network. Returns NULL on an unknown kind or a bad reference.
+     */
+    static IEvent* readEvent(std::istream& in, RailwayNetwork* network,
+                             const std::vector<Train*>& trains);
+    
 private:
     EventFactory(); // Private constructor - utility class
 };
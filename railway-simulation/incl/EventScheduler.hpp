@@ -0,0 +1,137 @@
+#ifndef EVENTSCHEDULER_HPP
+#define EVENTSCHEDULER_HPP
+
+#include "IEvent.hpp"
+#include "ISubject.hpp"
+#include "Types.hpp"
+#include <istream>
+#include <ostream>
+#include <vector>
+
+class RailwayNetwork;
+class Train;
+
+/**
+ * @brief An event with its activity window, as read from a scenario file
+ *
+ * An end before the start means the event never expires.
+ */
+struct ScheduledEvent {
+    IEvent* event;
+    Tick start;
+    Tick end;
+    
+    ScheduledEvent(IEvent* event, Tick start, Tick end)
+        : event(event), start(start), end(end) {}
+};
+
+/**
+ * @class EventScheduler
+ * @brief Time-ordered queue of IEvents with start and end times
+ *
+ * Each event has a start entry (IEvent::execute) and, if it is timed, an
+ * end entry (IEvent::expire) in one binary heap, so scheduling and
+ * processing an entry cost O(log n). Entries due at the same time run
+ * ends first, then in scheduling order, so back-to-back windows never
+ * overlap and the outcome is reproducible. The end of a window that closes
+ * when it opens runs in scheduling order too, right after its start.
+ */
+class EventScheduler {
+private:
+    struct Entry {
+        Tick time;
+        unsigned long sequence;
+        bool end;                // expire() rather than execute()
+        bool last;               // Final entry of the event: delete after it
+        bool empty;              // End of a window that closes when it opens
+        IEvent* event;
+    };
+    
+    struct Later {
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.time != b.time) {
+                return a.time > b.time;
+            }
+            bool aCloses = a.end && !a.empty;
+            bool bCloses = b.end && !b.empty;
+            if (aCloses != bCloses) {
+                return !aCloses;
+            }
+            return a.sequence > b.sequence;
+        }
+    };
+    
+    std::vector<Entry> _heap;
+    unsigned long _sequence;
+    
+    // Prevent copying
+    EventScheduler(const EventScheduler&);
+    EventScheduler& operator=(const EventScheduler&);
+
+public:
+    EventScheduler();
+    ~EventScheduler();
+    
+    /**
+     * @brief Queue an event (takes ownership)
+     * @param end Time to expire it; before @p start for a permanent event
+     */
+    void schedule(IEvent* event, Tick start, Tick end);
+    
+    /**
+     * @brief Run every entry due at or before the given time
+     * @param subject Receives a notification per entry (may be NULL)
+     * @return Number of entries run
+     */
+    size_t processUntil(Tick time, ISubject* subject);
+    
+    /**
+     * @brief Run the earliest entry only (the queue must not be empty)
+     */
+    void processNext(ISubject* subject);
+    
+    /**
+     * @brief Event of the earliest entry (the queue must not be empty)
+     */
+    const IEvent* nextEvent() const { return _heap.front().event; }
+    
+    bool empty() const { return _heap.empty(); }
+    size_t size() const { return _heap.size(); }
+    
+    /**
+     * @brief Time of the earliest entry (the queue must not be empty)
+     */
+    Tick nextTime() const { return _heap.front().time; }
+    
+    /**
+     * @brief Drop every pending event without running it
+     */
+    void clear();
+    
+    /**
+     * @brief Checkpoint support: write every pending entry
+     * @return false if an event does not support IEvent::save()
+     *
+     * The heap is written as it is, so a restored queue pops entries in
+     * exactly the same order.
+     */
+    bool save(std::ostream& out) const;
+    
+    /**
+     * @brief Replace the queue with one written by save()
+     *
+     * Events are recreated by EventFactory::readEvent() on the given
+     * network and trains. On failure the queue is left empty.
+     */
+    bool restore(std::istream& in, RailwayNetwork* network, const std::vector<Train*>& trains);
+    
+    /**
+     * @brief Exchange queues (and ownership of their events)
+     */
+    void swap(EventScheduler& other);
+
+private:
+    void push(Tick time, bool end, bool last, bool empty, IEvent* event);
+};
+
+#endif // EVENTSCHEDULER_HPP
@@ -1,6 +1,8 @@
 #ifndef IEVENT_HPP
 #define IEVENT_HPP
 
+#include <cstddef>
+#include <ostream>
 #include <string>
 
 class Train;
@@ -21,6 +23,27 @@ public:
      */
     virtual void execute() = 0;
     
+    /**
+     * @brief Undo the effect when a timed event ends (default: nothing)
+     */
+    virtual void expire() {}
+    
+    /**
+     * @brief Write the event to a checkpoint (default: not supported)
+     * @return false if the event cannot be saved; EventFactory::readEvent()
+     *         recreates the saved ones
+     */
+    virtual bool save(std::ostream& out) const { (void)out; return false; }
+    
+    /**
+     * @brief Train or rail the event acts on (default: NULL for both, it
+     *        may change any train)
+     *
+     * Lets DiscreteEventEngine re-plan only the trains an event can reach.
+     */
+    virtual Train* getTrain() const { return NULL; }
+    virtual Rail* getRail() const { return NULL; }
+    
     /**
      * @brief Get event description
      */
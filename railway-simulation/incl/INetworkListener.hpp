@@ -0,0 +1,29 @@
+#ifndef INETWORKLISTENER_HPP
+#define INETWORKLISTENER_HPP
+
+class Rail;
+
+/**
+ * @interface INetworkListener
+ * @brief Observer Pattern - Notified when the network topology or weights change
+ *
+ * Lets derived data (route caches, precomputed tables) invalidate
+ * themselves when RailwayNetwork is edited.
+ */
+class INetworkListener {
+public:
+    virtual ~INetworkListener() {}
+    
+    /**
+     * @brief Called after a rail has been added to the network
+     */
+    virtual void onRailAdded(Rail* rail) = 0;
+    
+    /**
+     * @brief Called after the speed limit of a rail has changed
+     * @param oldSpeedLimit Speed limit before the change (km/h)
+     */
+    virtual void onSpeedLimitChanged(Rail* rail, double oldSpeedLimit) = 0;
+};
+
+#endif // INETWORKLISTENER_HPP
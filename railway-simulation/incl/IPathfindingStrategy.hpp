@@ -22,6 +22,14 @@ public:
      * @return Vector of nodes representing the path
      */
     virtual std::vector<Node*> findPath(Node* start, Node* end) = 0;
+    
+    /**
+     * @brief Prototype - independent copy with its own search scratch
+     *
+     * Used to give each worker thread its own instance.
+     * @return NULL if the strategy cannot be copied (caller stays serial)
+     */
+    virtual IPathfindingStrategy* clone() const { return NULL; }
 };
 
 #endif // IPATHFINDINGSTRATEGY_HPP
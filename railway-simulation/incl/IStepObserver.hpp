@@ -0,0 +1,82 @@
+#ifndef ISTEPOBSERVER_HPP
+#define ISTEPOBSERVER_HPP
+
+#include "Rail.hpp"
+#include "RailwayNetwork.hpp"
+#include "Train.hpp"
+#include "Types.hpp"
+#include <vector>
+
+/**
+ * @class StepView
+ * @brief Read-only state of a simulation right after one step
+ *
+ * Valid only during IStepObserver::onStep(). Trains on the same rail are
+ * read from the rail's occupant list, so per-train queries about
+ * neighbours cost O(trains on that rail) instead of O(all trains).
+ */
+class StepView {
+private:
+    const RailwayNetwork* _network;
+    const std::vector<Train*>& _trains;
+    const std::vector<size_t>& _active;
+    size_t _index;
+    Tick _time;
+    Tick _step;
+
+public:
+    StepView(const RailwayNetwork* network, const std::vector<Train*>& trains,
+             const std::vector<size_t>& active, size_t index, Tick time, Tick step)
+        : _network(network), _trains(trains), _active(active), _index(index), _time(time), _step(step) {}
+
+    /**
+     * @brief 0-based number of this step since initialize()
+     */
+    size_t getIndex() const { return _index; }
+
+    /**
+     * @brief Clock at the start of the step; trains that moved read it too
+     */
+    Tick getStepStart() const { return _time - _step; }
+    Tick getTime() const { return _time; }
+    Tick getStepLength() const { return _step; }
+
+    /**
+     * @brief Network being simulated; it outlives the simulation, so
+     *        observers may keep it to resolve node and rail ids later
+     */
+    const RailwayNetwork* getNetwork() const { return _network; }
+    const std::vector<Train*>& getTrains() const { return _trains; }
+
+    /**
+     * @brief Indices into getTrains() of the trains still running, in
+     *        train order (trains that arrived in this step are not in it)
+     */
+    const std::vector<size_t>& getActiveTrains() const { return _active; }
+
+    /**
+     * @brief Trains on a rail, this simulation's and any other's; waiting
+     *        trains sit at the start of their first rail and arrived ones
+     *        at the end of their last
+     */
+    const std::vector<Train*>& getOccupants(const Rail* rail) const {
+        return rail->getOccupyingTrains();
+    }
+};
+
+/**
+ * @interface IStepObserver
+ * @brief Observer Pattern - Called by SimulationManager after every step
+ *
+ * Observers run on the stepping thread, in the order they were added,
+ * after collisions have been resolved. The event-driven mode has no
+ * steps and calls no observer.
+ */
+class IStepObserver {
+public:
+    virtual ~IStepObserver() {}
+
+    virtual void onStep(const StepView& view) = 0;
+};
+
+#endif // ISTEPOBSERVER_HPP
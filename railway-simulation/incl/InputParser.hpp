@@ -3,6 +3,7 @@
 
 #include "RailwayNetwork.hpp"
 #include "Train.hpp"
+#include "EventScheduler.hpp"
 #include <string>
 #include <vector>
 
@@ -19,6 +20,15 @@ public:
     static std::vector<Train*> parseTrainsFile(const std::string& filename, 
                                                 RailwayNetwork* network);
     
+    /**
+     * @brief Read timed disruptions for the given network and trains
+     *
+     * Invalid lines are reported and skipped, like train lines.
+     */
+    static std::vector<ScheduledEvent> parseEventsFile(const std::string& filename,
+                                                       RailwayNetwork* network,
+                                                       const std::vector<Train*>& trains);
+    
     static void printUsage();
     static void printHelp();
     
@@ -0,0 +1,82 @@
+#ifndef KINEMATICPROFILE_HPP
+#define KINEMATICPROFILE_HPP
+
+#include "Types.hpp"
+#include <istream>
+#include <ostream>
+#include <vector>
+
+class Train;
+
+/**
+ * @class KinematicProfile
+ * @brief Closed-form motion of a lone train over the rest of its route
+ *
+ * The route is split into constant-acceleration phases that follow the
+ * fixed-step rule of TrainStateStore: accelerate up to the cruise share
+ * of the rail's limit, hold, brake near each rail end, and take the next
+ * rail's limit on entering it. A lone train therefore arrives when it
+ * would under STEPPING_FIXED, give or take the step discretisation, and
+ * a follower that falls back to the stepped rule meets the same motion.
+ *
+ * The profile ignores other trains; it stays valid only while the train
+ * runs alone. Times are hours since build(), distances are km from the
+ * route start (Train::getDistanceTravelled()).
+ */
+class KinematicProfile {
+private:
+    struct Phase {
+        double startTime;
+        double startOffset;
+        double startSpeed;      // km/h
+        double accel;           // km/h²
+        TrainState state;
+    };
+
+    std::vector<Phase> _phases;
+    std::vector<double> _railExitTimes;
+    double _startOffset;
+    double _endOffset;
+    double _duration;
+    bool _stalled;
+
+public:
+    KinematicProfile();
+
+    /**
+     * @brief Plan from the train's current position and speed
+     */
+    void build(const Train& train);
+    void clear();
+    bool empty() const { return _phases.empty() && !_stalled; }
+
+    /**
+     * @brief Position, speed and state after the given hours
+     *
+     * Past the end of the profile the train is at the destination with
+     * zero speed, or wherever it stalled if it cannot move.
+     */
+    void sample(double hours, double& travelled, double& speed, TrainState& state) const;
+
+    /**
+     * @brief Hours until the train leaves each remaining rail, starting
+     *        with the current one; the last entry is the arrival time
+     */
+    const std::vector<double>& getRailExitTimes() const { return _railExitTimes; }
+    double getDuration() const { return _duration; }
+    bool isStalled() const { return _stalled; }
+    
+    /**
+     * @brief Checkpoint support: write / read back the planned phases
+     */
+    void save(std::ostream& out) const;
+    bool restore(std::istream& in);
+
+private:
+    void planRail(double length, double limit, double accel, double braking,
+                  double& time, double& offset, double& speed);
+    void addPhase(double time, double offset, double speed, double accel, TrainState state);
+    static double firstRoot(double a, double b, double c);
+};
+
+#endif // KINEMATICPROFILE_HPP
@@ -0,0 +1,95 @@
+#ifndef MONTECARLORUNNER_HPP
+#define MONTECARLORUNNER_HPP
+
+#include "RailwayNetwork.hpp"
+#include "SimulationManager.hpp"
+#include "Train.hpp"
+#include "Types.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Arrival delays of one train over all replications
+ *
+ * Delays are relative to the undisturbed run and sorted ascending.
+ * Replications where the train (or its undisturbed run) never arrives are
+ * only counted.
+ */
+struct DelayDistribution {
+    std::string trainName;
+    std::vector<Tick> delays;
+    size_t notArrived;
+    
+    DelayDistribution() : notArrived(0) {}
+    
+    Tick mean() const;
+    
+    /**
+     * @brief Nearest-rank percentile, p in [0, 100]
+     */
+    Tick percentile(double p) const;
+};
+
+/**
+ * @class MonteCarloRunner
+ * @brief Runs many disrupted replications of one scenario in parallel
+ *
+ * Each replication is an independent SimulationManager loaded with copies
+ * of the scenario. EventFactory draws one possible event per train (delay)
+ * and per rail (speed reduction) from a RandomStream keyed by (seed,
+ * replication), and each is scheduled at a drawn time within the span of
+ * the undisturbed run. Replications write only their own results and are
+ * aggregated in replication order, so a seed always gives the same
+ * distributions, whatever the thread count.
+ */
+class MonteCarloRunner {
+private:
+    const RailwayNetwork& _network;
+    const std::vector<Train*>& _trains;
+    size_t _replications;
+    unsigned long long _seed;
+    size_t _workerThreads;
+    SteppingMode _steppingMode;
+    std::vector<Tick> _baseline;          // Undisturbed arrivals, horizon for event times
+    std::vector<DelayDistribution> _results;
+    
+    // Prevent copying
+    MonteCarloRunner(const MonteCarloRunner&);
+    MonteCarloRunner& operator=(const MonteCarloRunner&);
+
+public:
+    /**
+     * @param network Parsed scenario, only read (also from worker threads)
+     * @param trains  Parsed trains, only read
+     */
+    MonteCarloRunner(const RailwayNetwork& network, const std::vector<Train*>& trains);
+    
+    // Setters
+    void setReplications(size_t replications) { _replications = replications; }
+    void setSeed(unsigned long long seed) { _seed = seed; }
+    void setWorkerThreads(size_t threads) { _workerThreads = threads; }
+    void setSteppingMode(SteppingMode mode) { _steppingMode = mode; }
+    
+    /**
+     * @brief Run the undisturbed scenario and every replication
+     */
+    void run();
+    
+    /**
+     * @brief One distribution per train, in scenario order
+     */
+    const std::vector<DelayDistribution>& getResults() const { return _results; }
+    
+    /**
+     * @brief Arrival tick of every train, -1 if it never arrives
+     * @param replication Stream number, or -1 for the undisturbed run
+     *
+     * A train's delay starts between its departure and its undisturbed
+     * arrival; a speed reduction starts between the first departure and
+     * the last undisturbed arrival and lasts 30 to 120 minutes. Before
+     * run() has the undisturbed arrivals, a day after departure is used.
+     */
+    void runReplication(long long replication, std::vector<Tick>& arrivals) const;
+};
+
+#endif // MONTECARLORUNNER_HPP
@@ -17,18 +17,20 @@ class Rail;
 class Node {
 private:
     std::string _name;
+    int _id;                     // Dense index assigned by RailwayNetwork
     std::vector<Rail*> _connectedRails;
     bool _isCity;
 
 public:
     // Constructor
-    explicit Node(const std::string& name);
+    Node(const std::string& name, int id);
     
     // Destructor
     ~Node();
     
     // Getters
     const std::string& getName() const { return _name; }
+    int getId() const { return _id; }
     const std::vector<Rail*>& getConnectedRails() const { return _connectedRails; }
     bool isCity() const { return _isCity; }
     
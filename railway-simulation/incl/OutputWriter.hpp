@@ -3,53 +3,95 @@
 
 #include "Train.hpp"
 #include "IObserver.hpp"
+#include "IStepObserver.hpp"
 #include <string>
 #include <fstream>
 #include <vector>
 
 /**
- * @struct SimulationSnapshot
- * @brief Captures train state at a moment in time
+ * @struct TraceRecord
+ * @brief Train state at one step, 24 bytes
+ *
+ * Nodes and the rail are stored by id and the state as its enum value;
+ * names and labels are looked up only when the file is written. The
+ * positions of the other trains live in the writer's shared pool.
  */
-struct SimulationSnapshot {
-    Time time;
-    std::string startNode;
-    std::string endNode;
-    double distanceRemaining;
-    std::string action;
-    double progressPercent;
-    double railLength;
-    std::vector<double> otherTrainPositions;
+struct TraceRecord {
+    int time;                      // Whole seconds since the scenario epoch
+    int rail;                      // Rail::getId()
+    int startNode;                 // Node::getId(); the rail's other end is next
+    float distanceRemaining;       // km to the destination
+    unsigned int positionsBegin;   // First entry in the position pool
+    unsigned short positionCount;
+    unsigned char state;           // TrainState
     
-    SimulationSnapshot() : distanceRemaining(0), progressPercent(0), railLength(0) {}
+    TraceRecord() : time(0), rail(-1), startNode(-1), distanceRemaining(0),
+                    positionsBegin(0), positionCount(0), state(STATE_STOPPED) {}
 };
+
 /**
  * @class OutputWriter
  * @brief Observes Train and logs simulation data
  * 
  * Implements Observer pattern to monitor Train state changes.
- * Records snapshots and generates output files for analysis.
+ * Records a TraceRecord per step and generates output files for analysis.
+ * As a step observer it records its train once the train's departure time
+ * is reached, reading the other trains from the train's rail only.
+ * In streaming mode only a window of records is kept; each full window
+ * is appended to the file and dropped. The file stays open, with its own
+ * write buffer, from the first window to writeToFile().
  */
-class OutputWriter : public IObserver {
+class OutputWriter : public IObserver, public IStepObserver {
 private:
     Train* _train;
     std::string _filename;
-    std::vector<SimulationSnapshot> _snapshots;
-    Time _estimatedTime;
+    const RailwayNetwork* _network;      // From the first step, resolves ids
+    std::vector<TraceRecord> _records;
+    std::vector<float> _positions;       // Other trains, km on the rail
+    Tick _estimatedTime;
+    size_t _window;                      // Streaming window, 0 keeps every record
+    bool _fileStarted;                   // Streamed header already written
+    std::streamoff _durationOffset;      // Reserved travel time in that header
+    std::vector<char> _buffer;           // Write buffer of _stream, declared first so it outlives it
+    std::ofstream _stream;               // Streamed file, open until writeToFile()
+    
+    // Prevent copying
+    OutputWriter(const OutputWriter&);
+    OutputWriter& operator=(const OutputWriter&);
 
 public:
     OutputWriter(Train* train);
     ~OutputWriter();
     
-    void addSnapshot(const SimulationSnapshot& snapshot);
-    void setEstimatedTime(const Time& time);
+    /**
+     * @brief Bytes held by the trace, records and position pool
+     */
+    size_t getTraceMemory() const;
+    
+    /**
+     * @brief Append rows to the file every `window` records instead of
+     *        keeping the whole trace; 0 turns streaming off
+     *
+     * The file is created at the first append with the travel time left
+     * blank and kept open. writeToFile() appends the last rows, fills the
+     * time in (padded with spaces to a fixed width) and closes it.
+     */
+    void setStreaming(size_t window);
+    bool isStreaming() const { return _window > 0; }
+    const std::string& getFilename() const { return _filename; }
+    void setEstimatedTime(Tick duration);
     void writeToFile();
     
     // IObserver implementation
     virtual void onNotify(const std::string& event);
     
+    // IStepObserver implementation
+    virtual void onStep(const StepView& view);
+    
 private:
-    std::string generateVisualGraph(const SimulationSnapshot& snapshot) const;
+    bool appendRecords();
+    void writeRecords(std::ostream& out) const;
+    std::string generateVisualGraph(const TraceRecord& record, double railLength) const;
     std::string formatNode(const std::string& nodeName) const;
 };
 
@@ -14,32 +14,84 @@
 class Train; // Forward declaration
 class Rail {
 private:
+    int _id;               // Dense index assigned by RailwayNetwork
     Node* _startNode;
     Node* _endNode;
     double _length;        // km
-    double _speedLimit;    // km/h
-    std::vector<Train*> _occupyingTrains;
+    double _speedLimit;    // km/h, effective (nominal under the strictest restriction)
+    double _nominalSpeedLimit;
+    std::vector<double> _speedFactors;  // Active temporary restrictions
+    std::vector<Train*> _occupyingTrains;  // Per direction, rear to front, see sortOccupants()
 
 public:
     // Constructor
-    Rail(Node* start, Node* end, double length, double speedLimit);
+    Rail(Node* start, Node* end, double length, double speedLimit, int id);
     
     // Destructor
     ~Rail();
     
     // Getters
+    int getId() const { return _id; }
     Node* getStartNode() const { return _startNode; }
     Node* getEndNode() const { return _endNode; }
     double getLength() const { return _length; }
     double getSpeedLimit() const { return _speedLimit; }
+    double getNominalSpeedLimit() const { return _nominalSpeedLimit; }
+    const std::vector<double>& getSpeedRestrictions() const { return _speedFactors; }
     const std::vector<Train*>& getOccupyingTrains() const { return _occupyingTrains; }
     
+    // Setters (use the RailwayNetwork versions so listeners are notified)
+    void setSpeedLimit(double speedLimit);
+    
+    /**
+     * @brief Temporary restriction to a fraction of the nominal limit
+     *
+     * Overlapping restrictions do not compound: the strictest one applies,
+     * and removing them all restores the nominal limit exactly.
+     */
+    void addSpeedRestriction(double factor);
+    void removeSpeedRestriction(double factor);
+    
+    /**
+     * @brief Checkpoint support: set the nominal limit and every active
+     *        restriction at once
+     */
+    void restoreSpeedLimit(double nominalSpeedLimit, const std::vector<double>& factors);
+    
     // Methods
     Node* getOtherNode(Node* node) const;
     void addTrain(Train* train);
     void removeTrain(Train* train);
+    
+    /**
+     * @brief Checkpoint support: add a train at the front without sorting,
+     *        so a saved occupant order comes back as it was
+     */
+    void appendTrain(Train* train);
     bool isOccupied() const;
-    Train* getTrainAhead(Train* train, double position) const;
+    
+    /**
+     * @brief Restore the rear-to-front order of the occupying trains
+     *
+     * Occupants are grouped by direction (the node they entered from) and
+     * ordered by distance within each group, so the train ahead of each
+     * one is its next neighbour if it shares that node. Trains at the same position
+     * (queued at a platform) are ordered by departure time, then id, the
+     * earlier one ahead. Positions only drift a little between steps, so
+     * this is an insertion sort over an almost sorted vector.
+     */
+    void sortOccupants();
+    
+    /**
+     * @brief Closest train ahead on this rail
+     *
+     * Relies on the order kept by sortOccupants(); occupants are compared
+     * at their current positions.
+     */
+    Train* getTrainAhead(Train* train) const;
+
+private:
+    void refreshSpeedLimit();
 };
 
 #endif // RAIL_HPP
@@ -4,6 +4,8 @@
 #include "Node.hpp"
 #include "Rail.hpp"
 #include "Types.hpp"
+#include "INetworkListener.hpp"
+#include "CsrGraph.hpp"
 #include <map>
 #include <string>
 #include <vector>
@@ -18,7 +20,11 @@
 class RailwayNetwork {
 private:
     std::map<std::string, Node*> _nodes;
+    std::vector<Node*> _nodesById;     // Indexed by Node::getId()
     std::vector<Rail*> _rails;
+    std::vector<INetworkListener*> _listeners;
+    mutable CsrGraph _graph;
+    mutable bool _graphDirty;
 
 public:
     RailwayNetwork();
@@ -27,17 +33,48 @@ public:
     // Node management
     Node* addNode(const std::string& name);
     Node* getNode(const std::string& name) const;
+    Node* getNodeById(int id) const;
+    const std::vector<Node*>& getNodes() const { return _nodesById; }
     bool hasNode(const std::string& name) const;
     
     // Rail management
     Rail* addRail(const std::string& startName, const std::string& endName,
                   double length, double speedLimit);
     const std::vector<Rail*>& getRails() const { return _rails; }
+    void setRailSpeedLimit(Rail* rail, double speedLimit);
+    void addSpeedRestriction(Rail* rail, double factor);
+    void removeSpeedRestriction(Rail* rail, double factor);
+    void restoreSpeedLimit(Rail* rail, double nominalSpeedLimit,
+                           const std::vector<double>& factors);
+    
+    /**
+     * @brief CSR snapshot of the current topology and travel-time weights
+     *
+     * Rebuilt lazily after any edit. Call it once before sharing the
+     * network between threads so no reader triggers the rebuild.
+     */
+    const CsrGraph& getGraph() const;
+    
+    // Change notification
+    void addListener(INetworkListener* listener);
+    void removeListener(INetworkListener* listener);
+    
+    /**
+     * @brief Independent copy of the nodes and rails
+     *
+     * Node and rail ids are preserved. Listeners, occupancy, temporary
+     * speed restrictions and the CSR snapshot are not copied, so each simulation context can take its
+     * own copy of a network parsed once.
+     */
+    RailwayNetwork* clone() const;
     
     // Utility
     void clear();
     size_t getNodeCount() const { return _nodes.size(); }
     size_t getRailCount() const { return _rails.size(); }
+
+private:
+    void speedLimitChanged(Rail* rail, double oldSpeedLimit);
 };
 
 #endif // RAILWAYNETWORK_HPP
@@ -0,0 +1,37 @@
+#ifndef RANDOMSTREAM_HPP
+#define RANDOMSTREAM_HPP
+
+/**
+ * @class RandomStream
+ * @brief Counter-based pseudo-random numbers
+ *
+ * The n-th draw is a hash of (seed, stream, n), so a stream depends only
+ * on its two keys and how many values were taken from it: replications
+ * with different stream numbers are independent and reproducible
+ * whichever thread runs them, unlike the global rand().
+ */
+class RandomStream {
+private:
+    unsigned long long _key;
+    unsigned long long _counter;
+
+public:
+    RandomStream(unsigned long long seed, unsigned long long stream);
+
+    unsigned long long next();
+
+    /**
+     * @brief Uniform integer in [0, bound)
+     */
+    int nextInt(int bound);
+
+    /**
+     * @brief Uniform double in [0, 1)
+     */
+    double nextDouble();
+
+private:
+    static unsigned long long mix(unsigned long long value);
+};
+
+#endif // RANDOMSTREAM_HPP
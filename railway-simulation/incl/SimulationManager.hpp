@@ -3,64 +3,294 @@
 
 #include "RailwayNetwork.hpp"
 #include "Train.hpp"
+#include "EventScheduler.hpp"
 #include "IPathfindingStrategy.hpp"
+#include "IStepObserver.hpp"
 #include "ISubject.hpp"
+#include "KinematicProfile.hpp"
+#include "TrainStateStore.hpp"
+#include <string>
+#include <utility>
 #include <vector>
 
+class ThreadPool;
+class DijkstraPathfinding;
+class DiscreteEventEngine;
+
+/**
+ * @enum RoutingMode
+ * @brief How initialize() computes train routes
+ *
+ * ROUTING_POINT_TO_POINT asks the pathfinding strategy once per train.
+ * ROUTING_SHARED_TREES builds one shortest-path tree per distinct departure
+ * node and reads every train's route from it, so the cost scales with the
+ * number of origins instead of the number of trains.
+ */
+enum RoutingMode {
+    ROUTING_POINT_TO_POINT,
+    ROUTING_SHARED_TREES
+};
+
+/**
+ * @enum SteppingMode
+ * @brief How run() advances simulated time
+ *
+ * STEPPING_FIXED moves every train by _timeStep per step.
+ * STEPPING_EVENT_DRIVEN hands the trains to a DiscreteEventEngine that
+ * jumps from one event to the next, so idle hours cost nothing.
+ * STEPPING_ANALYTIC keeps the fixed steps but moves a train with no train
+ * close ahead along its KinematicProfile, so its motion does not depend
+ * on the step size; only interacting trains use per-step speed updates.
+ */
+enum SteppingMode {
+    STEPPING_FIXED,
+    STEPPING_EVENT_DRIVEN,
+    STEPPING_ANALYTIC
+};
+
 /**
  * @class SimulationManager
  * @brief Singleton Pattern - Manages the entire simulation
  * 
  * Central controller for the railway simulation.
- * Implements Singleton to ensure only one simulation instance.
+ * getInstance() gives the process-wide instance used by the CLI; any
+ * number of independent instances can also be constructed directly; they
+ * share no mutable state, so each can run on its own thread.
  * SOLID: Single Responsibility - coordinates simulation
  */
-class SimulationManager : public ISubject {
+class SimulationManager : public ISubject, public INetworkListener {
 private:
     static SimulationManager* _instance;
     
     RailwayNetwork* _network;
     std::vector<Train*> _trains;
     IPathfindingStrategy* _pathfinder;
-    Time _currentTime;
-    int _timeStepMinutes;
-    
-    // Private constructor for Singleton
-    SimulationManager();
+    Tick _currentTime;
+    Tick _timeStep;
+    Tick _step;                  // Length of the step in progress
+    bool _adaptiveStep;
+    Tick _minStep;
+    Tick _maxStep;
+    RoutingMode _routingMode;
+    SteppingMode _steppingMode;
+    size_t _workerThreads;
+    std::vector<KinematicProfile> _profiles;   // STEPPING_ANALYTIC, per train
+    std::vector<double> _profileHours;         // Hours since each profile was built
+    TrainStateStore _stateStore;               // Runtime state of _trains
+    std::vector<double> _leaderGaps;           // km to the train ahead, see sweepRails()
+    std::vector<size_t> _activeRails;          // Rail ids holding _active trains, ascending
+    std::vector<unsigned int> _railStamp;      // Rail id -> last collectActiveRails() pass
+    unsigned int _railPass;
+    std::vector<double> _pendingTravelled;     // Analytic moves applied in the commit phase
+    std::vector<std::pair<Tick, size_t> > _departures;  // Min-heap of trains waiting to leave
+    std::vector<size_t> _active;               // Departed, not arrived, in train order
+    std::vector<size_t> _activeBlocks;         // INTEGRATE_BLOCK ranges holding _active
+    std::vector<unsigned char> _departing;     // Released this step, see planTrain()
+    size_t _arrivedCount;                      // Arrived, or without a route
+    bool _scheduled;                           // The four above match _trains
+    std::vector<IStepObserver*> _stepObservers;
+    size_t _stepCount;                         // Steps since initialize()
+    size_t _maxSteps;                          // Safety limit of run()
+    ThreadPool* _stepPool;                     // NULL when steps run on the caller only
+    EventScheduler _events;                    // Disruptions, applied as the clock reaches them
+    bool _ownsScenario;                        // Network and trains came from loadScenario()
+    bool _rerouting;
+    bool _listening;                           // Registered with _network
+    std::vector<std::vector<size_t> > _trainsByRail;    // Rail id -> trains routed over it
+    std::vector<std::vector<size_t> > _divertedByRail;  // Rail id -> trains re-routed off it
+    std::vector<DijkstraPathfinding*> _rerouters;       // One per step thread, current weights
+    size_t _rerouteCount;
+    DiscreteEventEngine* _engine;              // Set while runEventDriven() runs
     
     // Prevent copying
     SimulationManager(const SimulationManager&);
     SimulationManager& operator=(const SimulationManager&);
 
 public:
+    SimulationManager();
     ~SimulationManager();
     
     // Singleton access
     static SimulationManager* getInstance();
     static void destroyInstance();
     
-    // Initialization
+    // Initialization (network and trains stay owned by the caller)
     void setNetwork(RailwayNetwork* network);
+    
+    /**
+     * @brief Add a train; its id becomes its 1-based position in this simulation
+     */
     void addTrain(Train* train);
     void setPathfindingStrategy(IPathfindingStrategy* strategy);
     
+    /**
+     * @brief Run on private copies of a parsed network and its trains
+     *
+     * The copies are owned and deleted by this simulation, so one parsed
+     * scenario can feed many concurrent simulations. Replaces any
+     * network, trains and pathfinding strategy set before; set a custom
+     * strategy afterwards, on getNetwork().
+     */
+    void loadScenario(const RailwayNetwork& network, const std::vector<Train*>& trains);
+    
+    /**
+     * @brief Apply an event between two times (takes ownership)
+     *
+     * The event executes at the first step at or after @p start and
+     * expires at the first step at or after @p end; an end before the
+     * start keeps it for the rest of the run. Events must refer to this
+     * simulation's network and trains.
+     */
+    void scheduleEvent(IEvent* event, Tick start, Tick end);
+    
     // Simulation control
     void initialize();
+    
+    /**
+     * @brief Step until every train has arrived or getMaxSteps() steps
+     *        have run (one event-driven run in STEPPING_EVENT_DRIVEN)
+     */
     void run();
+    /**
+     * @brief Advance by one step
+     *
+     * Only departed trains are visited: waiting trains sit in a heap
+     * keyed by departure time until their turn, and arrived trains drop
+     * out, so a step costs O(moving trains). A waiting train's clock keeps
+     * the run's start time until it departs.
+     */
     void step();
+    
+    /**
+     * @brief Every train has arrived (O(1) once initialized)
+     */
     bool isComplete() const;
     
+    /**
+     * @brief Write the full run state to a binary file between two steps
+     *
+     * Saves the clock, every train's state, speed, clock, route and
+     * position, rail speed limits and occupancy, analytic profiles,
+     * re-routing bookkeeping and pending events. Settings (time step,
+     * modes, threads) are not saved. Fails if a pending event does not
+     * support IEvent::save().
+     */
+    bool saveCheckpoint(const std::string& filename) const;
+    
+    /**
+     * @brief Continue from a checkpoint instead of calling initialize()
+     *
+     * The simulation must hold the scenario the checkpoint was taken from
+     * (same network and trains, in the same order, e.g. from
+     * loadScenario()); no routes are computed. With the same settings,
+     * stepping on gives bit-identical results to the original run, so a
+     * run can be resumed or forked into several what-ifs. On failure
+     * nothing is changed.
+     */
+    bool restoreCheckpoint(const std::string& filename);
+    
+    /**
+     * @brief Call an observer after every step (not owned)
+     */
+    void addStepObserver(IStepObserver* observer);
+    void removeStepObserver(IStepObserver* observer);
+    
     // Getters
     RailwayNetwork* getNetwork() const { return _network; }
     const std::vector<Train*>& getTrains() const { return _trains; }
-    const Time& getCurrentTime() const { return _currentTime; }
-    int getTimeStepMinutes() const { return _timeStepMinutes; }
+    Tick getCurrentTime() const { return _currentTime; }
+    Tick getTimeStep() const { return _timeStep; }
+    Tick getLastStep() const { return _step; }
+    bool isAdaptiveStep() const { return _adaptiveStep; }
+    RoutingMode getRoutingMode() const { return _routingMode; }
+    SteppingMode getSteppingMode() const { return _steppingMode; }
+    size_t getWorkerThreads() const { return _workerThreads; }
+    size_t getStepCount() const { return _stepCount; }
+    size_t getMaxSteps() const { return _maxSteps; }
     
     // Setters
-    void setTimeStepMinutes(int minutes) { _timeStepMinutes = minutes; }
+    void setTimeStep(Tick step) { _timeStep = step; }
+    void setTimeStepMinutes(int minutes) { _timeStep = minutes * TICKS_PER_MINUTE; }
+    void setMaxSteps(size_t steps) { _maxSteps = steps; }
+    
+    /**
+     * @brief Choose each step from the nearest critical distance
+     *
+     * When enabled, step() advances by the time the fastest-approaching
+     * train needs to reach its nearest rail end, braking point or safety
+     * gap to the train ahead, at its current traction or braking, clamped
+     * to [minStep, maxStep] and never past the next scheduled departure.
+     * A step also changes no train's speed by more than a tenth, which
+     * bounds the overshoot of the end-of-step speed used by the update.
+     */
+    void setAdaptiveStep(bool enabled) { _adaptiveStep = enabled; }
+    void setStepBounds(Tick minStep, Tick maxStep);
+    void setRoutingMode(RoutingMode mode) { _routingMode = mode; }
+    void setSteppingMode(SteppingMode mode) { _steppingMode = mode; }
+    
+    /**
+     * @brief Threads used to compute routes in initialize() and trains in step()
+     *
+     * 1 (default) keeps the serial loop, 0 uses every core; takes effect
+     * at the next initialize(). Routes are computed in parallel with one
+     * strategy clone per thread, then assigned to trains serially in train
+     * order. Each step first computes every train's new speed and position
+     * in parallel from the state left by the previous step, then moves
+     * trains between rails and resolves collisions serially in train
+     * order, so the outcome does not depend on the thread count.
+     */
+    void setWorkerThreads(size_t threads) { _workerThreads = threads; }
+    
+    /**
+     * @brief Re-route trains when a rail's speed limit changes
+     *
+     * Takes effect at the next initialize(); the network must outlive
+     * this simulation or be replaced first. A slower or closed rail (limit
+     * 0) re-routes only the trains whose remaining route crosses it, found
+     * through a rail-to-trains index; when it speeds up again the trains
+     * diverted off it are offered their old way back. Each search starts
+     * at the end of the train's current rail (a train still at its origin
+     * may change its first rail) and runs a bidirectional Dijkstra on the
+     * current weights, whatever strategy planned the original routes. The
+     * searches share the step threads (setWorkerThreads()); new routes are
+     * applied in train order.
+     */
+    void setRerouting(bool enabled);
+    bool isRerouting() const { return _rerouting; }
+    size_t getRerouteCount() const { return _rerouteCount; }
+    
+    // INetworkListener implementation
+    virtual void onRailAdded(Rail* rail);
+    virtual void onSpeedLimitChanged(Rail* rail, double oldSpeedLimit);
     
 private:
+    class StepTask;
+    friend class StepTask;
+    
+
+    void releaseScenario();
+    void prepareRun();
+    void rebuildSchedule();
+    void releaseDepartures();
+    void retireArrived();
+    void stopListening();
+    void indexRoute(size_t index, size_t fromSegment);
+    size_t reroutePoint(size_t index) const;
+    void reroute(const std::vector<size_t>& indices, Rail* cause);
+    bool applyRoute(size_t index, size_t from, const std::vector<Node*>& route, Rail* cause);
+    void releaseRerouters();
+    void applyEvents();
+    void computeRoutes(std::vector<std::vector<Node*> >& routes);
+    void computeRoutesFromTrees(std::vector<std::vector<Node*> >& routes);
+    void assignRoute(Train* train, const std::vector<Node*>& path);
+    void runEventDriven();
+    void collectActiveRails();
+    void sweepRails();
+    Tick chooseStep() const;
     void updateTrains();
+    void planTrain(size_t index, double stepHours);
+    bool isInteracting(size_t index) const;
+    void planAnalytic(size_t index, double hours);
     void checkCollisions();
     void handleTrainInteractions();
 };
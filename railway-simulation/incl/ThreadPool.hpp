@@ -0,0 +1,70 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <pthread.h>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @interface IParallelTask
+ * @brief Work item executed by ThreadPool for every index of a range
+ */
+class IParallelTask {
+public:
+    virtual ~IParallelTask() {}
+    
+    /**
+     * @brief Process one index
+     * @param index Item in [0, count)
+     * @param worker Worker slot in [0, getThreadCount()), for per-thread scratch
+     */
+    virtual void execute(size_t index, size_t worker) = 0;
+};
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of POSIX worker threads running parallel-for loops
+ *
+ * run() hands out indices in chunks and blocks until all of them are done.
+ * The calling thread takes part as worker 0, so a pool of 1 runs inline
+ * with no threads at all. Results are deterministic as long as tasks
+ * only write to their own index.
+ */
+class ThreadPool {
+private:
+    std::vector<pthread_t> _threads;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _workReady;
+    pthread_cond_t _workDone;
+    
+    IParallelTask* _task;
+    size_t _count;
+    size_t _next;
+    size_t _chunk;
+    size_t _busy;                // Spawned workers still on the current run
+    unsigned int _generation;    // Incremented by every run()
+    bool _stop;
+    
+    // Prevent copying
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+public:
+    /**
+     * @param threadCount Total workers including the caller (0 = all cores)
+     */
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+    
+    void run(IParallelTask& task, size_t count);
+    size_t getThreadCount() const { return _threads.size() + 1; }
+    
+    static size_t hardwareThreads();
+    
+private:
+    static void* workerEntry(void* arg);
+    void workerLoop(size_t worker);
+    void drain(size_t worker);
+};
+
+#endif // THREADPOOL_HPP
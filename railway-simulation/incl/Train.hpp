@@ -4,10 +4,14 @@
 #include "Node.hpp"
 #include "Rail.hpp"
 #include "Types.hpp"
+#include "TrainStateStore.hpp"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
+class RailwayNetwork;
+
 /**
  * @class Train
  * @brief Represents a train with physical properties and state
@@ -17,9 +21,16 @@
  */
 class Train {
 private:
-    static int _nextId;
+    /**
+     * @brief One rail of the route, resolved once by setPath()
+     */
+    struct Segment {
+        Rail* rail;
+        double length;           // km, 0 if the hop has no rail
+        double startOffset;      // km from the route start (prefix sum)
+    };
     
-    int _id;
+    int _id;                     // Assigned by the owning SimulationManager
     std::string _name;
     double _weight;              // metric tons
     double _frictionCoeff;
@@ -27,23 +38,27 @@ private:
     double _maxBrakeForce;       // kN
     Node* _departure;
     Node* _destination;
-    Time _departureTime;
-    Time _stopDuration;
+    Tick _departureTime;
+    Tick _stopDuration;
     
-    // Runtime state
+    // Runtime state, held here until bound to a TrainStateStore slot
+    TrainStateStore* _store;
+    size_t _slot;
     TrainState _state;
     double _currentSpeed;        // km/h
-    Position _position;
+    mutable Position _position;  // distanceOnRail refreshed from the slot
     std::vector<Node*> _path;
+    std::vector<Segment> _segments;  // _path[i] -> _path[i + 1]
+    double _routeLength;             // km, sum of segment lengths
     size_t _currentPathIndex;
-    Time _currentTime;
-    double _totalDistanceToGo;
+    Tick _currentTime;
+    Tick _holdUntil;             // Held in place by a DelayEvent until then
     
 public:
     // Constructor
     Train(const std::string& name, double weight, double friction,
           double maxAccel, double maxBrake, Node* dep, Node* dest,
-          const Time& depTime, const Time& stopDur);
+          Tick depTime, Tick stopDur);
     
     // Destructor
     ~Train();
@@ -57,28 +72,137 @@ public:
     double getMaxBrakeForce() const { return _maxBrakeForce; }
     Node* getDeparture() const { return _departure; }
     Node* getDestination() const { return _destination; }
-    const Time& getDepartureTime() const { return _departureTime; }
-    const Time& getStopDuration() const { return _stopDuration; }
-    TrainState getState() const { return _state; }
-    double getCurrentSpeed() const { return _currentSpeed; }
-    const Position& getPosition() const { return _position; }
+    Tick getDepartureTime() const { return _departureTime; }
+    Tick getStopDuration() const { return _stopDuration; }
+    TrainState getState() const {
+        return _store ? static_cast<TrainState>(_store->stateAt(_slot)) : _state;
+    }
+    double getCurrentSpeed() const { return _store ? _store->speedAt(_slot) : _currentSpeed; }
+    const Position& getPosition() const {
+        _position.distanceOnRail = distanceOnRail();
+        return _position;
+    }
     const std::vector<Node*>& getPath() const { return _path; }
-    const Time& getCurrentTime() const { return _currentTime; }
-    double getTotalDistanceToGo() const { return _totalDistanceToGo; }
+    size_t getCurrentPathIndex() const { return _currentPathIndex; }
+    double getRouteLength() const { return _routeLength; }
+    double getDistanceTravelled() const { return _routeLength - getTotalDistanceToGo(); }
+    size_t getSegmentCount() const { return _segments.size(); }
+    const Rail* getSegmentRail(size_t index) const { return _segments[index].rail; }
+    double getSegmentLength(size_t index) const { return _segments[index].length; }
+    Tick getCurrentTime() const { return _store ? _store->timeAt(_slot) : _currentTime; }
+    double getTotalDistanceToGo() const;
     
     // Setters
-    void setState(TrainState state) { _state = state; }
-    void setCurrentSpeed(double speed) { _currentSpeed = speed; }
+    void setState(TrainState state) {
+        if (_store) {
+            _store->stateAt(_slot) = state;
+        } else {
+            _state = state;
+        }
+    }
+    void setCurrentSpeed(double speed) { speedRef() = speed; }
     void setPath(const std::vector<Node*>& path);
-    void setCurrentTime(const Time& time) { _currentTime = time; }
+    
+    /**
+     * @brief Replace the route after one of its nodes
+     * @param pathIndex Index in getPath() of route.front(); the rails before
+     *                  it are kept
+     *
+     * pathIndex must not lie behind the train. When it is the train's
+     * current node (a train still at its origin) the train moves onto the
+     * first rail of the new route.
+     */
+    bool replaceRouteFrom(size_t pathIndex, const std::vector<Node*>& route);
+    void setCurrentTime(Tick time) { timeRef() = time; }
+    void setId(int id) { _id = id; }
+    void delayDeparture(Tick delay) { _departureTime += delay; }
+    void setDepartureTime(Tick time) { _departureTime = time; }
+    
+    /**
+     * @brief Stop a running train where it is for the given time
+     *
+     * Counted from the train's clock; holds add up.
+     */
+    void holdFor(Tick delay) { _holdUntil = std::max(_holdUntil, getCurrentTime()) + delay; }
+    Tick getHoldUntil() const { return _holdUntil; }
+    void setHoldUntil(Tick time) { _holdUntil = time; }
+    
+    /**
+     * @brief Checkpoint support: put the train back on a saved route
+     * @param pathIndex      Current index in the route, as getCurrentPathIndex()
+     * @param distanceOnRail km on that rail
+     *
+     * Rail occupancy is left to the caller.
+     */
+    void restoreProgress(const std::vector<Node*>& path, size_t pathIndex,
+                         double distanceOnRail);
+    
+    /**
+     * @brief Keep the runtime state in a store slot (NULL: back in the Train)
+     *
+     * Current values move with the state, so binding never changes what
+     * the getters return.
+     */
+    void bindState(TrainStateStore* store, size_t slot);
+    size_t getStateSlot() const { return _slot; }
+    
+    /**
+     * @brief New train with the same parameters on another copy of the network
+     *
+     * Departure and destination are looked up by node id, so @p network
+     * must come from RailwayNetwork::clone() of this train's network.
+     * Route and runtime state are not copied.
+     */
+    Train* clone(const RailwayNetwork* network) const;
     
     // Methods
     void updatePosition(double timeStepMinutes);
+    
+    /**
+     * @brief Move the train forward along its route
+     *
+     * Reaching the end of the current rail moves the train onto the next
+     * one (surplus distance is dropped) or stops it at the destination.
+     */
+    void advance(double distance);
+    
+    /**
+     * @brief Move the train to a distance from the route start, crossing
+     *        as many rails as needed (never moves backwards)
+     */
+    void moveTo(double travelled);
     double calculateAcceleration(double speedLimit) const;
+    
+    /**
+     * @brief Net traction acceleration (km/h²) below any speed limit
+     */
+    double calculateTractiveAcceleration() const;
     double calculateBraking() const;
+    
+    /**
+     * @brief Stopped at the end of its route; never for a train without one
+     */
     bool hasArrived() const;
-    void updateTotalDistance();
+    
+    /**
+     * @brief Waiting at the origin or arrived: off the running line
+     */
+    bool isAtStation() const;
     std::string getStateString() const;
+    
+    /**
+     * @brief Output label of a state, e.g. "Speed up"
+     */
+    static const char* getStateName(TrainState state);
+    
+private:
+    void appendSegments(size_t from);
+    double& speedRef() { return _store ? _store->speedAt(_slot) : _currentSpeed; }
+    Tick& timeRef() { return _store ? _store->timeAt(_slot) : _currentTime; }
+    double distanceOnRail() const {
+        return _store ? _store->distanceAt(_slot) : _position.distanceOnRail;
+    }
+    void setDistanceOnRail(double distance);
 };
 
 #endif // TRAIN_HPP
@@ -0,0 +1,111 @@
+#ifndef TRAINSTATESTORE_HPP
+#define TRAINSTATESTORE_HPP
+
+#include "Types.hpp"
+#include <vector>
+
+class Train;
+
+/**
+ * @class TrainStateStore
+ * @brief Structure-of-arrays runtime state for every simulated train
+ *
+ * Speed, distance on rail, state and clock of each bound Train live in
+ * contiguous arrays; Train getters and setters read and write its slot.
+ * The per-step speed/position rules of the fixed-step loop run as one
+ * pass over these arrays (SSE2 when available, two trains per lane),
+ * together with the per-train acceleration and braking constants and the
+ * current rail's length and speed limit.
+ *
+ * Only trains marked with prepare() take part in a step, and endStep()
+ * clears their marks again, so a step costs nothing for the others.
+ * Trains that reach the end of their rail are left for the caller, which
+ * moves them onto the next rail with Train::advance(getStepDistance()).
+ */
+class TrainStateStore {
+private:
+    // Train view
+    std::vector<double> _speed;         // km/h
+    std::vector<double> _distance;      // km on the current rail
+    std::vector<int> _state;            // TrainState
+    std::vector<Tick> _time;
+
+    // Kernel inputs, refreshed by prepare() each step
+    std::vector<double> _railLength;    // km
+    std::vector<double> _speedLimit;    // km/h
+    std::vector<double> _accel;         // km/h², traction below the limit
+    std::vector<double> _brake;         // km/h²
+    std::vector<double> _active;        // 1.0 if part of this step
+    std::vector<double> _brakeAhead;    // 1.0 if a train is within the safety gap
+
+    // Kernel outputs
+    std::vector<double> _stepDistance;  // km travelled this step
+    std::vector<unsigned char> _railEnd;
+
+    std::vector<Train*> _trains;
+
+    TrainStateStore(const TrainStateStore&);
+    TrainStateStore& operator=(const TrainStateStore&);
+
+public:
+    TrainStateStore();
+    ~TrainStateStore();
+
+    /**
+     * @brief Move the trains' runtime state into the store and bind them
+     */
+    void bind(const std::vector<Train*>& trains);
+
+    /**
+     * @brief Copy the state back into the trains and detach them
+     */
+    void unbind();
+
+    size_t size() const { return _trains.size(); }
+    
+    // Step rule, shared with KinematicProfile
+    static const double CRUISE_FRACTION;    // Below this share of the limit, accelerate
+    static const double BRAKING_ZONE;       // km before the rail end
+    
+    /**
+     * @brief Distance (km) under which a train near the rail end brakes
+     * @param braking Train::calculateBraking(); max() if it is not positive
+     */
+    static double stoppingDistance(double speed, double braking);
+
+    double& speedAt(size_t slot) { return _speed[slot]; }
+    double& distanceAt(size_t slot) { return _distance[slot]; }
+    int& stateAt(size_t slot) { return _state[slot]; }
+    Tick& timeAt(size_t slot) { return _time[slot]; }
+    double speedAt(size_t slot) const { return _speed[slot]; }
+    double distanceAt(size_t slot) const { return _distance[slot]; }
+    int stateAt(size_t slot) const { return _state[slot]; }
+    Tick timeAt(size_t slot) const { return _time[slot]; }
+
+    /**
+     * @brief Clear the marks left by a step
+     * @param slots Every slot that may have been prepared in it
+     */
+    void endStep(const std::vector<size_t>& slots);
+
+    /**
+     * @brief Include a train in this step
+     */
+    void prepare(size_t slot, double railLength, double speedLimit, bool brakeAhead);
+
+    /**
+     * @brief Update speed, state and distance of the prepared trains in [begin, end)
+     * @param stepHours Step length, for both speed and position
+     *
+     * Slots are independent, so disjoint ranges may run on different threads.
+     */
+    void integrate(size_t begin, size_t end, double stepHours);
+
+    bool reachedRailEnd(size_t slot) const { return _railEnd[slot] != 0; }
+    double getStepDistance(size_t slot) const { return _stepDistance[slot]; }
+
+private:
+    void integrateScalar(size_t begin, size_t end, double stepHours);
+};
+
+#endif // TRAINSTATESTORE_HPP
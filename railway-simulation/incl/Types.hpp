@@ -2,7 +2,28 @@
 #define TYPES_HPP
 
 #include <string>
-// Time structure
+
+/**
+ * @brief Absolute simulation clock: milliseconds since the scenario epoch
+ *        (midnight of the first day)
+ *
+ * 64-bit, so sub-minute steps and multi-day timetables need no wrapping;
+ * arithmetic and comparisons are plain integer operations. Convert to
+ * text only at output with formatClock() / formatDuration().
+ *
+ * C++98 has no integer type guaranteed to hold 64 bits, so this uses
+ * `long long` from C99/C++11, an extension every supported compiler
+ * accepts in -std=c++98 mode. It is the only one: the Makefile builds with
+ * -pedantic and only -Wno-long-long.
+ */
+typedef long long Tick;
+
+const Tick TICKS_PER_SECOND = 1000;
+const Tick TICKS_PER_MINUTE = 60 * TICKS_PER_SECOND;
+const Tick TICKS_PER_HOUR = 60 * TICKS_PER_MINUTE;
+const Tick TICKS_PER_DAY = 24 * TICKS_PER_HOUR;
+
+// Time of day as read from input files (HHhMM)
 
 class Time {
 public:
@@ -25,11 +46,21 @@ public:
     int toMinutes() const {
         return hours * 60 + minutes;
     } 
-    operator bool() const {
-        return hours != 0 || minutes != 0;
+    Tick toTicks() const {
+        return hours * TICKS_PER_HOUR + minutes * TICKS_PER_MINUTE;
     }
 };
 
+/**
+ * @brief "HHhMM" time of day, with a "+Nd" suffix after the first day
+ */
+std::string formatClock(Tick tick);
+
+/**
+ * @brief "HHhMM" length of an interval; hours do not wrap at 24
+ */
+std::string formatDuration(Tick ticks);
+
 class Position {
 public:
     class Rail* currentRail;
@@ -46,5 +77,10 @@ enum TrainState {
     STATE_BRAKING
 };
 
+/**
+ * @brief Whether a stored integer names a TrainState, e.g. read from a file
+ */
+bool isTrainState(int value);
+
 #endif // TYPES_HPP
 
@@ -0,0 +1,197 @@
+#include "../incl/AltPathfinding.hpp"
+#include "../incl/DijkstraPathfinding.hpp"
+#include "../incl/Rail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+AltPathfinding::AltPathfinding() : _network(NULL), _query(0), _settled(0) {
+}
+
+AltPathfinding::~AltPathfinding() {
+}
+
+IPathfindingStrategy* AltPathfinding::clone() const {
+    return new AltPathfinding(*this);
+}
+
+void AltPathfinding::preprocess(const RailwayNetwork& network, size_t landmarkCount) {
+    const double INF = std::numeric_limits<double>::max();
+
+    _network = &network;
+    _nodes = network.getNodes();
+    size_t nodeCount = _nodes.size();
+    _landmarks.clear();
+    _landmarkDist.clear();
+    _dist.assign(nodeCount, 0.0);
+    _bound.assign(nodeCount, 0.0);
+    _prev.assign(nodeCount, NULL);
+    _stamp.assign(nodeCount, 0u);
+    _query = 0;
+
+    if (nodeCount == 0) {
+        return;
+    }
+    landmarkCount = std::min(landmarkCount, nodeCount);
+
+    // Prefer cities as landmarks; fall back to every node if there are too few
+    std::vector<Node*> candidates;
+    for (size_t i = 0; i < nodeCount; ++i) {
+        if (_nodes[i]->isCity()) {
+            candidates.push_back(_nodes[i]);
+        }
+    }
+    if (candidates.size() < landmarkCount) {
+        candidates = _nodes;
+    }
+
+    // Farthest-point selection: each new landmark is the candidate with the
+    // largest distance to its closest already chosen landmark
+    DijkstraPathfinding dijkstra(&network);
+    std::vector<double> closest(nodeCount, INF);
+    std::vector<double> distances;
+    std::vector<Node*> previous;
+    Node* next = candidates[0];
+
+    while (_landmarks.size() < landmarkCount && next != NULL) {
+        _landmarks.push_back(next);
+        dijkstra.computeTree(next, nodeCount, distances, previous);
+        _landmarkDist.insert(_landmarkDist.end(), distances.begin(), distances.end());
+
+        for (size_t i = 0; i < nodeCount; ++i) {
+            closest[i] = std::min(closest[i], distances[i]);
+        }
+
+        next = NULL;
+        double farthest = 0.0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            double d = closest[candidates[i]->getId()];
+            // An unreachable candidate (other component) makes a good landmark
+            if (d > farthest) {
+                farthest = d;
+                next = candidates[i];
+            }
+        }
+    }
+}
+
+double AltPathfinding::heuristic(int node, int target) const {
+    const double INF = std::numeric_limits<double>::max();
+    size_t nodeCount = _nodes.size();
+    double bound = 0.0;
+
+    for (size_t l = 0; l < _landmarks.size(); ++l) {
+        const double* table = &_landmarkDist[l * nodeCount];
+        double toNode = table[node];
+        double toTarget = table[target];
+        if (toNode == INF || toTarget == INF) {
+            continue; // Landmark gives no information across components
+        }
+        bound = std::max(bound, std::fabs(toTarget - toNode));
+    }
+    return bound;
+}
+
+double AltPathfinding::distanceOf(int id) const {
+    if (_stamp[id] != _query) {
+        return std::numeric_limits<double>::max();
+    }
+    return _dist[id];
+}
+
+std::vector<Node*> AltPathfinding::findPath(Node* start, Node* end) {
+    std::vector<Node*> path;
+    _settled = 0;
+
+    if (start == NULL || end == NULL) {
+        return path;
+    }
+
+    if (start == end) {
+        path.push_back(start);
+        return path;
+    }
+
+    int source = start->getId();
+    int target = end->getId();
+    int nodeCount = static_cast<int>(_nodes.size());
+    if (source < 0 || source >= nodeCount || _nodes[source] != start ||
+        target < 0 || target >= nodeCount || _nodes[target] != end) {
+        return path; // Tables not built for this network
+    }
+
+    const CsrGraph& graph = _network->getGraph();
+    if (graph.getNodeCount() != _nodes.size()) {
+        return path; // Nodes added since preprocess()
+    }
+
+    _query++;
+    if (_query == 0) {
+        std::fill(_stamp.begin(), _stamp.end(), 0u);
+        _query = 1;
+    }
+
+    // Heap entries are (distance + heuristic, node id)
+    typedef std::pair<double, int> HeapEntry;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                        std::greater<HeapEntry> > heap;
+
+    _dist[source] = 0.0;
+    _bound[source] = heuristic(source, target);
+    _prev[source] = NULL;
+    _stamp[source] = _query;
+    heap.push(HeapEntry(_bound[source], source));
+
+    bool found = false;
+
+    while (!heap.empty()) {
+        HeapEntry top = heap.top();
+        heap.pop();
+
+        int currentId = top.second;
+        double currentDist = _dist[currentId];
+        if (top.first > currentDist + _bound[currentId]) {
+            continue; // Stale entry
+        }
+
+        Node* current = _nodes[currentId];
+        _settled++;
+
+        if (current == end) {
+            found = true;
+            break;
+        }
+
+        for (CsrGraph::Index e = graph.getEdgeBegin(currentId);
+             e < graph.getEdgeEnd(currentId); ++e) {
+            double newDist = currentDist + graph.getWeight(e);
+            int neighborId = static_cast<int>(graph.getTarget(e));
+
+            if (newDist < distanceOf(neighborId)) {
+                if (_stamp[neighborId] != _query) {
+                    _bound[neighborId] = heuristic(neighborId, target);
+                }
+                _dist[neighborId] = newDist;
+                _prev[neighborId] = current;
+                _stamp[neighborId] = _query;
+                heap.push(HeapEntry(newDist + _bound[neighborId], neighborId));
+            }
+        }
+    }
+
+    if (!found) {
+        return path; // No path found
+    }
+
+    for (Node* current = end; current != NULL; current = _prev[current->getId()]) {
+        path.push_back(current);
+        if (current == start) {
+            break;
+        }
+    }
+    std::reverse(path.begin(), path.end());
+
+    return path;
+}
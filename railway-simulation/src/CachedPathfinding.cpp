@@ -0,0 +1,111 @@
+#include "../incl/CachedPathfinding.hpp"
+
+CachedPathfinding::CachedPathfinding(IPathfindingStrategy* inner, RailwayNetwork* network)
+    : _inner(inner), _network(network), _hits(0), _misses(0), _invalidations(0) {
+    if (_network != NULL) {
+        _network->addListener(this);
+    }
+}
+
+CachedPathfinding::~CachedPathfinding() {
+    if (_network != NULL) {
+        _network->removeListener(this);
+    }
+    delete _inner;
+}
+
+IPathfindingStrategy* CachedPathfinding::clone() const {
+    IPathfindingStrategy* inner = (_inner != NULL) ? _inner->clone() : NULL;
+    if (inner == NULL) {
+        return NULL;
+    }
+    return new CachedPathfinding(inner, _network);
+}
+
+std::vector<Node*> CachedPathfinding::findPath(Node* start, Node* end) {
+    return getRoute(start, end);
+}
+
+const std::vector<Node*>& CachedPathfinding::getRoute(Node* start, Node* end) {
+    static const std::vector<Node*> noRoute;
+    
+    if (start == NULL || end == NULL || _inner == NULL) {
+        return noRoute;
+    }
+    
+    RouteKey key(start->getId(), end->getId());
+    std::map<RouteKey, std::vector<Node*> >::iterator it = _routes.find(key);
+    if (it != _routes.end()) {
+        _hits++;
+        return it->second;
+    }
+    
+    _misses++;
+    std::vector<Node*>& route = _routes[key];
+    route = _inner->findPath(start, end);
+    
+    // Index the route by every rail it uses
+    for (size_t i = 0; i + 1 < route.size(); ++i) {
+        Rail* rail = route[i]->getRailTo(route[i + 1]);
+        if (rail != NULL) {
+            _routesByRail[rail].insert(key);
+        }
+    }
+    return route;
+}
+
+void CachedPathfinding::clear() {
+    if (!_routes.empty()) {
+        _invalidations += _routes.size();
+    }
+    _routes.clear();
+    _routesByRail.clear();
+}
+
+void CachedPathfinding::invalidateRail(const Rail* rail) {
+    std::map<const Rail*, std::set<RouteKey> >::iterator it = _routesByRail.find(rail);
+    if (it == _routesByRail.end()) {
+        return;
+    }
+    
+    // dropRoute() edits the index, this rail's entry included
+    std::vector<RouteKey> keys(it->second.begin(), it->second.end());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        dropRoute(keys[i]);
+    }
+}
+
+void CachedPathfinding::dropRoute(const RouteKey& key) {
+    std::map<RouteKey, std::vector<Node*> >::iterator it = _routes.find(key);
+    if (it == _routes.end()) {
+        return;
+    }
+    
+    // Unlist the route from every rail it uses
+    const std::vector<Node*>& route = it->second;
+    for (size_t i = 0; i + 1 < route.size(); ++i) {
+        std::map<const Rail*, std::set<RouteKey> >::iterator entry =
+            _routesByRail.find(route[i]->getRailTo(route[i + 1]));
+        if (entry != _routesByRail.end()) {
+            entry->second.erase(key);
+            if (entry->second.empty()) {
+                _routesByRail.erase(entry);
+            }
+        }
+    }
+    _routes.erase(it);
+    _invalidations++;
+}
+
+void CachedPathfinding::onRailAdded(Rail* rail) {
+    (void)rail;
+    clear();
+}
+
+void CachedPathfinding::onSpeedLimitChanged(Rail* rail, double oldSpeedLimit) {
+    if (rail->getSpeedLimit() > oldSpeedLimit) {
+        clear();
+    } else {
+        invalidateRail(rail);
+    }
+}
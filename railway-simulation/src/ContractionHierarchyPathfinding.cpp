@@ -0,0 +1,551 @@
+#include "../incl/ContractionHierarchyPathfinding.hpp"
+#include "../incl/DijkstraPathfinding.hpp"
+#include "../incl/Rail.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+
+namespace {
+
+const char CH_MAGIC[4] = { 'R', 'S', 'C', 'H' };
+const unsigned int CH_VERSION = 1;
+const int WITNESS_SETTLE_LIMIT = 500;     // When actually contracting
+const int ESTIMATE_SETTLE_LIMIT = 50;     // When only estimating priority
+
+typedef std::pair<double, int> HeapEntry;
+typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                            std::greater<HeapEntry> > MinHeap;
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return in.good();
+}
+
+// FNV-1a over the rail list, so a hierarchy saved for another network
+// version (different rails, lengths or speed limits) is rejected on load
+unsigned int networkFingerprint(const RailwayNetwork& network) {
+    unsigned int hash = 2166136261u;
+    const std::vector<Rail*>& rails = network.getRails();
+
+    for (size_t i = 0; i < rails.size(); ++i) {
+        int ids[2] = { rails[i]->getStartNode()->getId(),
+                       rails[i]->getEndNode()->getId() };
+        double weight = DijkstraPathfinding::calculateCost(rails[i]);
+        unsigned char bytes[sizeof(ids) + sizeof(weight)];
+        std::memcpy(bytes, ids, sizeof(ids));
+        std::memcpy(bytes + sizeof(ids), &weight, sizeof(weight));
+        for (size_t b = 0; b < sizeof(bytes); ++b) {
+            hash ^= bytes[b];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+} // namespace
+
+ContractionHierarchyPathfinding::ContractionHierarchyPathfinding()
+    : _fingerprint(0), _query(0), _witnessQuery(0) {
+}
+
+ContractionHierarchyPathfinding::~ContractionHierarchyPathfinding() {
+}
+
+IPathfindingStrategy* ContractionHierarchyPathfinding::clone() const {
+    return new ContractionHierarchyPathfinding(*this);
+}
+
+size_t ContractionHierarchyPathfinding::getShortcutCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < _upward.size(); ++i) {
+        for (size_t j = 0; j < _upward[i].size(); ++j) {
+            if (_upward[i][j].middle >= 0) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// ============================================================================
+// Preprocessing
+// ============================================================================
+
+void ContractionHierarchyPathfinding::addOrImprove(
+        std::vector<std::vector<Edge> >& graph,
+        int from, int to, double weight, int middle) {
+    std::vector<Edge>& edges = graph[from];
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (edges[i].to == to) {
+            if (weight < edges[i].weight) {
+                edges[i].weight = weight;
+                edges[i].middle = middle;
+            }
+            return;
+        }
+    }
+    edges.push_back(Edge(to, weight, middle));
+}
+
+void ContractionHierarchyPathfinding::nextWitnessQuery() {
+    _witnessQuery++;
+    if (_witnessQuery == 0) {
+        std::fill(_witnessStamp.begin(), _witnessStamp.end(), 0u);
+        std::fill(_targetMark.begin(), _targetMark.end(), 0u);
+        _witnessQuery = 1;
+    }
+}
+
+double ContractionHierarchyPathfinding::witnessDistance(int id) const {
+    if (_witnessStamp[id] != _witnessQuery) {
+        return std::numeric_limits<double>::max();
+    }
+    return _witnessDist[id];
+}
+
+void ContractionHierarchyPathfinding::witnessSearch(
+        const std::vector<std::vector<Edge> >& graph,
+        const std::vector<bool>& contracted,
+        int source, int excluded, double limit, int settleLimit,
+        int targets) {
+
+    MinHeap heap;
+    _witnessDist[source] = 0.0;
+    _witnessStamp[source] = _witnessQuery;
+    heap.push(HeapEntry(0.0, source));
+    int settled = 0;
+
+    while (!heap.empty() && settled < settleLimit) {
+        HeapEntry top = heap.top();
+        heap.pop();
+
+        if (top.first > _witnessDist[top.second]) {
+            continue; // Stale entry
+        }
+        if (top.first > limit) {
+            break;
+        }
+        settled++;
+        if (_targetMark[top.second] == _witnessQuery && --targets == 0) {
+            break; // Every neighbor of interest is settled
+        }
+
+        const std::vector<Edge>& edges = graph[top.second];
+        for (size_t i = 0; i < edges.size(); ++i) {
+            int next = edges[i].to;
+            if (next == excluded || contracted[next]) {
+                continue;
+            }
+            double newDist = top.first + edges[i].weight;
+            if (newDist < witnessDistance(next)) {
+                _witnessDist[next] = newDist;
+                _witnessStamp[next] = _witnessQuery;
+                heap.push(HeapEntry(newDist, next));
+            }
+        }
+    }
+}
+
+int ContractionHierarchyPathfinding::contract(
+        std::vector<std::vector<Edge> >& graph,
+        const std::vector<bool>& contracted, int node, bool simulate) {
+    // Remaining neighbors of the node being contracted
+    std::vector<Edge> neighbors;
+    double maxWeight = 0.0;
+    const std::vector<Edge>& edges = graph[node];
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (!contracted[edges[i].to]) {
+            neighbors.push_back(edges[i]);
+            maxWeight = std::max(maxWeight, edges[i].weight);
+        }
+    }
+
+    int shortcuts = 0;
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+        if (neighbors.size() - i <= 1) {
+            break;
+        }
+        nextWitnessQuery();
+        for (size_t j = i + 1; j < neighbors.size(); ++j) {
+            _targetMark[neighbors[j].to] = _witnessQuery;
+        }
+        witnessSearch(graph, contracted, neighbors[i].to, node,
+                      neighbors[i].weight + maxWeight,
+                      simulate ? ESTIMATE_SETTLE_LIMIT : WITNESS_SETTLE_LIMIT,
+                      static_cast<int>(neighbors.size() - i - 1));
+
+        for (size_t j = i + 1; j < neighbors.size(); ++j) {
+            double via = neighbors[i].weight + neighbors[j].weight;
+            if (witnessDistance(neighbors[j].to) <= via) {
+                continue; // A path avoiding the node is as short
+            }
+            shortcuts++;
+            if (!simulate) {
+                addOrImprove(graph, neighbors[i].to, neighbors[j].to, via, node);
+                addOrImprove(graph, neighbors[j].to, neighbors[i].to, via, node);
+            }
+        }
+    }
+    return shortcuts;
+}
+
+void ContractionHierarchyPathfinding::preprocess(const RailwayNetwork& network) {
+    const std::vector<Node*>& nodes = network.getNodes();
+    const std::vector<Rail*>& rails = network.getRails();
+    int nodeCount = static_cast<int>(nodes.size());
+
+    _nodes = nodes;
+    _fingerprint = networkFingerprint(network);
+    _rank.assign(nodeCount, 0);
+    _upward.assign(nodeCount, std::vector<Edge>());
+    _witnessDist.assign(nodeCount, 0.0);
+    _witnessStamp.assign(nodeCount, 0u);
+    _targetMark.assign(nodeCount, 0u);
+    _witnessQuery = 0;
+
+    // Working graph: both directions of every rail, parallel rails merged
+    std::vector<std::vector<Edge> > graph(nodeCount);
+    for (size_t i = 0; i < rails.size(); ++i) {
+        int a = rails[i]->getStartNode()->getId();
+        int b = rails[i]->getEndNode()->getId();
+        double weight = DijkstraPathfinding::calculateCost(rails[i]);
+        if (a == b || weight == std::numeric_limits<double>::max()) {
+            continue;
+        }
+        addOrImprove(graph, a, b, weight, -1);
+        addOrImprove(graph, b, a, weight, -1);
+    }
+
+    // Edge-difference ordering with lazy priority updates
+    std::vector<bool> contracted(nodeCount, false);
+    std::vector<int> deletedNeighbors(nodeCount, 0);
+    MinHeap order;
+
+    for (int v = 0; v < nodeCount; ++v) {
+        int priority = contract(graph, contracted, v, true)
+                     - static_cast<int>(graph[v].size());
+        order.push(HeapEntry(priority, v));
+    }
+
+    int nextRank = 0;
+    while (!order.empty()) {
+        int v = order.top().second;
+        order.pop();
+        if (contracted[v]) {
+            continue;
+        }
+
+        int degree = 0;
+        for (size_t i = 0; i < graph[v].size(); ++i) {
+            if (!contracted[graph[v][i].to]) {
+                degree++;
+            }
+        }
+        double priority = contract(graph, contracted, v, true) - degree
+                        + deletedNeighbors[v];
+        if (!order.empty() && priority > order.top().first) {
+            order.push(HeapEntry(priority, v)); // Re-queue with fresh priority
+            continue;
+        }
+
+        contract(graph, contracted, v, false);
+        contracted[v] = true;
+        _rank[v] = nextRank++;
+
+        // Every remaining edge now leads to a higher-ranked node; move them
+        // to the upward graph and detach v from the working graph
+        for (size_t i = 0; i < graph[v].size(); ++i) {
+            int neighbor = graph[v][i].to;
+            if (contracted[neighbor]) {
+                continue;
+            }
+            _upward[v].push_back(graph[v][i]);
+            deletedNeighbors[neighbor]++;
+
+            std::vector<Edge>& back = graph[neighbor];
+            for (size_t j = 0; j < back.size(); ++j) {
+                if (back[j].to == v) {
+                    back[j] = back.back();
+                    back.pop_back();
+                    break;
+                }
+            }
+        }
+        std::vector<Edge>().swap(graph[v]);
+    }
+
+    _witnessDist.clear();
+    _witnessStamp.clear();
+    _targetMark.clear();
+}
+
+// ============================================================================
+// Persistence
+// ============================================================================
+
+bool ContractionHierarchyPathfinding::saveToFile(const std::string& filename) const {
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "ERROR: Cannot create hierarchy file: " << filename << std::endl;
+        return false;
+    }
+
+    out.write(CH_MAGIC, sizeof(CH_MAGIC));
+    writeValue(out, CH_VERSION);
+
+    unsigned int nodeCount = static_cast<unsigned int>(_nodes.size());
+    writeValue(out, _fingerprint);
+    writeValue(out, nodeCount);
+
+    for (size_t v = 0; v < _nodes.size(); ++v) {
+        const std::string& name = _nodes[v]->getName();
+        unsigned int length = static_cast<unsigned int>(name.size());
+        writeValue(out, length);
+        out.write(name.data(), length);
+        writeValue(out, _rank[v]);
+
+        unsigned int edgeCount = static_cast<unsigned int>(_upward[v].size());
+        writeValue(out, edgeCount);
+        for (size_t i = 0; i < _upward[v].size(); ++i) {
+            writeValue(out, _upward[v][i].to);
+            writeValue(out, _upward[v][i].weight);
+            writeValue(out, _upward[v][i].middle);
+        }
+    }
+
+    return out.good();
+}
+
+bool ContractionHierarchyPathfinding::loadFromFile(const std::string& filename,
+                                                   const RailwayNetwork& network) {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    char magic[sizeof(CH_MAGIC)];
+    unsigned int version = 0;
+    unsigned int fingerprint = 0;
+    unsigned int nodeCount = 0;
+
+    in.read(magic, sizeof(magic));
+    if (!in.good() || std::memcmp(magic, CH_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != CH_VERSION ||
+        !readValue(in, fingerprint) || !readValue(in, nodeCount) ||
+        fingerprint != networkFingerprint(network) ||
+        nodeCount != network.getNodeCount()) {
+        return false;
+    }
+
+    std::vector<int> rank(nodeCount);
+    std::vector<std::vector<Edge> > upward(nodeCount);
+
+    for (unsigned int v = 0; v < nodeCount; ++v) {
+        unsigned int length = 0;
+        if (!readValue(in, length) || length > 4096) {
+            return false;
+        }
+        std::string name(length, '\0');
+        if (length > 0) {
+            in.read(&name[0], length);
+        }
+        Node* node = network.getNodeById(static_cast<int>(v));
+        if (!in.good() || node == NULL || node->getName() != name) {
+            return false;
+        }
+
+        unsigned int edgeCount = 0;
+        if (!readValue(in, rank[v]) || !readValue(in, edgeCount) ||
+            edgeCount > nodeCount) {
+            return false;
+        }
+        for (unsigned int i = 0; i < edgeCount; ++i) {
+            Edge edge(0, 0.0, -1);
+            if (!readValue(in, edge.to) || !readValue(in, edge.weight) ||
+                !readValue(in, edge.middle) ||
+                edge.to < 0 || static_cast<unsigned int>(edge.to) >= nodeCount ||
+                edge.middle >= static_cast<int>(nodeCount)) {
+                return false;
+            }
+            upward[v].push_back(edge);
+        }
+    }
+
+    _nodes = network.getNodes();
+    _fingerprint = fingerprint;
+    _rank.swap(rank);
+    _upward.swap(upward);
+    return true;
+}
+
+// ============================================================================
+// Query
+// ============================================================================
+
+void ContractionHierarchyPathfinding::resetScratch() {
+    size_t nodeCount = _nodes.size();
+    for (int side = 0; side < 2; ++side) {
+        if (_dist[side].size() != nodeCount) {
+            _dist[side].assign(nodeCount, 0.0);
+            _parent[side].assign(nodeCount, -1);
+            _parentMiddle[side].assign(nodeCount, -1);
+            _stamp[side].assign(nodeCount, 0u);
+        }
+    }
+
+    _query++;
+    if (_query == 0) {
+        std::fill(_stamp[0].begin(), _stamp[0].end(), 0u);
+        std::fill(_stamp[1].begin(), _stamp[1].end(), 0u);
+        _query = 1;
+    }
+}
+
+double ContractionHierarchyPathfinding::distanceOf(int side, int id) const {
+    if (_stamp[side][id] != _query) {
+        return std::numeric_limits<double>::max();
+    }
+    return _dist[side][id];
+}
+
+int ContractionHierarchyPathfinding::findMiddle(int a, int b) const {
+    int low = (_rank[a] < _rank[b]) ? a : b;
+    int high = (low == a) ? b : a;
+
+    const std::vector<Edge>& edges = _upward[low];
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (edges[i].to == high) {
+            return edges[i].middle;
+        }
+    }
+    return -1;
+}
+
+void ContractionHierarchyPathfinding::unpackEdge(int from, int to, int middle,
+                                                 std::vector<int>& out) const {
+    if (middle < 0) {
+        out.push_back(to);
+        return;
+    }
+    unpackEdge(from, middle, findMiddle(from, middle), out);
+    unpackEdge(middle, to, findMiddle(middle, to), out);
+}
+
+std::vector<Node*> ContractionHierarchyPathfinding::findPath(Node* start, Node* end) {
+    std::vector<Node*> path;
+
+    if (start == NULL || end == NULL) {
+        return path;
+    }
+
+    if (start == end) {
+        path.push_back(start);
+        return path;
+    }
+
+    int source = start->getId();
+    int target = end->getId();
+    int nodeCount = static_cast<int>(_nodes.size());
+    if (source < 0 || source >= nodeCount || _nodes[source] != start ||
+        target < 0 || target >= nodeCount || _nodes[target] != end) {
+        return path; // Hierarchy not built for this network
+    }
+
+    resetScratch();
+
+    MinHeap heaps[2];
+    int roots[2] = { source, target };
+    for (int side = 0; side < 2; ++side) {
+        _dist[side][roots[side]] = 0.0;
+        _parent[side][roots[side]] = -1;
+        _parentMiddle[side][roots[side]] = -1;
+        _stamp[side][roots[side]] = _query;
+        heaps[side].push(HeapEntry(0.0, roots[side]));
+    }
+
+    double best = std::numeric_limits<double>::max();
+    int meeting = -1;
+
+    // Alternate the two upward searches; a side is finished once its
+    // smallest key can no longer improve the best meeting distance
+    while (!heaps[0].empty() || !heaps[1].empty()) {
+        int side;
+        if (heaps[0].empty()) {
+            side = 1;
+        } else if (heaps[1].empty()) {
+            side = 0;
+        } else {
+            side = (heaps[0].top().first <= heaps[1].top().first) ? 0 : 1;
+        }
+
+        HeapEntry top = heaps[side].top();
+        heaps[side].pop();
+
+        if (top.first > _dist[side][top.second]) {
+            continue; // Stale entry
+        }
+        if (top.first >= best) {
+            heaps[side] = MinHeap();
+            continue;
+        }
+
+        int current = top.second;
+        double other = distanceOf(1 - side, current);
+        if (other != std::numeric_limits<double>::max() &&
+            top.first + other < best) {
+            best = top.first + other;
+            meeting = current;
+        }
+
+        const std::vector<Edge>& edges = _upward[current];
+        for (size_t i = 0; i < edges.size(); ++i) {
+            double newDist = top.first + edges[i].weight;
+            if (newDist < distanceOf(side, edges[i].to)) {
+                _dist[side][edges[i].to] = newDist;
+                _parent[side][edges[i].to] = current;
+                _parentMiddle[side][edges[i].to] = edges[i].middle;
+                _stamp[side][edges[i].to] = _query;
+                heaps[side].push(HeapEntry(newDist, edges[i].to));
+            }
+        }
+    }
+
+    if (meeting < 0) {
+        return path; // No path found
+    }
+
+    // Forward half: source .. meeting, walked back then reversed
+    std::vector<int> upChain;
+    for (int v = meeting; v != -1; v = _parent[0][v]) {
+        upChain.push_back(v);
+    }
+    std::reverse(upChain.begin(), upChain.end());
+
+    std::vector<int> ids;
+    ids.push_back(source);
+    for (size_t i = 1; i < upChain.size(); ++i) {
+        unpackEdge(upChain[i - 1], upChain[i],
+                   _parentMiddle[0][upChain[i]], ids);
+    }
+
+    // Backward half: meeting .. target
+    for (int v = meeting; v != target; v = _parent[1][v]) {
+        unpackEdge(v, _parent[1][v], _parentMiddle[1][v], ids);
+    }
+
+    path.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        path.push_back(_nodes[ids[i]]);
+    }
+    return path;
+}
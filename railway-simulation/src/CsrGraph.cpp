@@ -0,0 +1,45 @@
+#include "../incl/CsrGraph.hpp"
+#include "../incl/RailwayNetwork.hpp"
+#include "../incl/DijkstraPathfinding.hpp"
+
+CsrGraph::CsrGraph() {
+    _offsets.push_back(0);
+}
+
+CsrGraph::~CsrGraph() {
+}
+
+void CsrGraph::build(const RailwayNetwork& network) {
+    const std::vector<Node*>& nodes = network.getNodes();
+
+    _nodes = nodes;
+    _offsets.assign(nodes.size() + 1, 0);
+    for (size_t v = 0; v < nodes.size(); ++v) {
+        _offsets[v + 1] = _offsets[v]
+                        + static_cast<Index>(nodes[v]->getConnectedRails().size());
+    }
+
+    Index edgeCount = _offsets[nodes.size()];
+    _targets.resize(edgeCount);
+    _weights.resize(edgeCount);
+    _rails.resize(edgeCount);
+
+    for (size_t v = 0; v < nodes.size(); ++v) {
+        const std::vector<Rail*>& rails = nodes[v]->getConnectedRails();
+        Index edge = _offsets[v];
+        for (size_t i = 0; i < rails.size(); ++i, ++edge) {
+            _targets[edge] = static_cast<Index>(rails[i]->getOtherNode(nodes[v])->getId());
+            _weights[edge] = DijkstraPathfinding::calculateCost(rails[i]);
+            _rails[edge] = rails[i];
+        }
+    }
+}
+
+Rail* CsrGraph::findRail(Index from, Index to) const {
+    for (Index edge = _offsets[from]; edge < _offsets[from + 1]; ++edge) {
+        if (_targets[edge] == to) {
+            return _rails[edge];
+        }
+    }
+    return NULL;
+}
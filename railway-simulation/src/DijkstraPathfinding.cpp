@@ -1,18 +1,25 @@
 #include "../incl/DijkstraPathfinding.hpp"
 #include "../incl/Rail.hpp"
-#include <map>
-#include <set>
+#include "../incl/RailwayNetwork.hpp"
+#include <queue>
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <functional>
 
-DijkstraPathfinding::DijkstraPathfinding() {
+DijkstraPathfinding::DijkstraPathfinding(const RailwayNetwork* network,
+                                         DijkstraSearchMode mode)
+    : _network(network), _mode(mode), _query(0), _settled(0) {
 }
 
 DijkstraPathfinding::~DijkstraPathfinding() {
 }
 
-double DijkstraPathfinding::calculateCost(Rail* rail) const {
+IPathfindingStrategy* DijkstraPathfinding::clone() const {
+    return new DijkstraPathfinding(_network, _mode);
+}
+
+double DijkstraPathfinding::calculateCost(const Rail* rail) {
     if (rail == NULL) {
         return std::numeric_limits<double>::max();
     }
@@ -29,6 +36,143 @@ double DijkstraPathfinding::calculateCost(Rail* rail) const {
     return distance / speed; // Time-based cost
 }
 
+void DijkstraPathfinding::ensureCapacity(int id) {
+    size_t needed = static_cast<size_t>(id) + 1;
+    if (needed > _dist.size()) {
+        _dist.resize(needed, std::numeric_limits<double>::max());
+        _prev.resize(needed, NULL);
+        _stamp.resize(needed, 0);
+        _node.resize(needed, NULL);
+        _distBack.resize(needed, std::numeric_limits<double>::max());
+        _next.resize(needed, NULL);
+        _stampBack.resize(needed, 0);
+    }
+}
+
+void DijkstraPathfinding::nextQuery() {
+    // New query generation invalidates all scratch entries at once
+    _query++;
+    if (_query == 0) {
+        std::fill(_stamp.begin(), _stamp.end(), 0u);
+        std::fill(_stampBack.begin(), _stampBack.end(), 0u);
+        _query = 1;
+    }
+    _settled = 0;
+}
+
+double DijkstraPathfinding::distanceOf(int id) const {
+    if (static_cast<size_t>(id) >= _stamp.size() || _stamp[id] != _query) {
+        return std::numeric_limits<double>::max();
+    }
+    return _dist[id];
+}
+
+double DijkstraPathfinding::backDistanceOf(int id) const {
+    if (static_cast<size_t>(id) >= _stampBack.size() || _stampBack[id] != _query) {
+        return std::numeric_limits<double>::max();
+    }
+    return _distBack[id];
+}
+
+void DijkstraPathfinding::relaxNeighbors(Node* current, double currentDist, int side,
+                                         MinHeap& heap, double* best, Node** meeting) {
+    std::vector<double>& dist = (side == 0) ? _dist : _distBack;
+    std::vector<Node*>& link = (side == 0) ? _prev : _next;
+    std::vector<unsigned int>& stamp = (side == 0) ? _stamp : _stampBack;
+    const std::vector<unsigned int>& otherStamp = (side == 0) ? _stampBack : _stamp;
+    const std::vector<double>& otherDist = (side == 0) ? _distBack : _dist;
+    
+    // Contiguous CSR arrays when the network is known, object graph otherwise
+    const CsrGraph* graph = (_network != NULL) ? &_network->getGraph() : NULL;
+    size_t begin = 0;
+    size_t end = 0;
+    const std::vector<Rail*>* rails = NULL;
+    if (graph != NULL) {
+        begin = graph->getEdgeBegin(current->getId());
+        end = graph->getEdgeEnd(current->getId());
+    } else {
+        rails = &current->getConnectedRails();
+        end = rails->size();
+    }
+    
+    for (size_t e = begin; e < end; ++e) {
+        int neighborId;
+        double cost;
+        if (graph != NULL) {
+            neighborId = static_cast<int>(graph->getTarget(e));
+            cost = graph->getWeight(e);
+        } else {
+            Node* neighbor = (*rails)[e]->getOtherNode(current);
+            if (neighbor == NULL) {
+                continue;
+            }
+            neighborId = neighbor->getId();
+            cost = calculateCost((*rails)[e]);
+            ensureCapacity(neighborId);
+            _node[neighborId] = neighbor;
+        }
+        
+        double newDist = currentDist + cost;
+        bool seen = static_cast<size_t>(neighborId) < stamp.size()
+                 && stamp[neighborId] == _query;
+        
+        if (newDist < (seen ? dist[neighborId] : std::numeric_limits<double>::max())) {
+            ensureCapacity(neighborId);
+            dist[neighborId] = newDist;
+            link[neighborId] = current;
+            stamp[neighborId] = _query;
+            if (graph != NULL) {
+                _node[neighborId] = graph->getNode(neighborId);
+            }
+            heap.push(HeapEntry(newDist, neighborId));
+        }
+        
+        // Bidirectional mode: do the two frontiers meet through this rail?
+        // A closed rail (cost max()) relaxes nothing, so neither side may
+        // have reached the neighbour or sized the scratch for it yet
+        if (best != NULL && static_cast<size_t>(neighborId) < otherStamp.size() &&
+            stamp[neighborId] == _query && otherStamp[neighborId] == _query &&
+            dist[neighborId] + otherDist[neighborId] < *best) {
+            *best = dist[neighborId] + otherDist[neighborId];
+            *meeting = _node[neighborId];
+        }
+    }
+}
+
+bool DijkstraPathfinding::search(Node* start, Node* end) {
+    nextQuery();
+    
+    MinHeap heap;
+    
+    ensureCapacity(start->getId());
+    _dist[start->getId()] = 0.0;
+    _prev[start->getId()] = NULL;
+    _stamp[start->getId()] = _query;
+    _node[start->getId()] = start;
+    heap.push(HeapEntry(0.0, start->getId()));
+    
+    while (!heap.empty()) {
+        HeapEntry top = heap.top();
+        heap.pop();
+        
+        int currentId = top.second;
+        if (top.first > _dist[currentId]) {
+            continue; // Stale entry
+        }
+        
+        Node* current = _node[currentId];
+        _settled++;
+        
+        if (current == end) {
+            return true; // Found destination
+        }
+        
+        relaxNeighbors(current, top.first, 0, heap, NULL, NULL);
+    }
+    
+    return end == NULL;
+}
+
 std::vector<Node*> DijkstraPathfinding::findPath(Node* start, Node* end) {
     std::vector<Node*> path;
     
@@ -41,79 +185,108 @@ std::vector<Node*> DijkstraPathfinding::findPath(Node* start, Node* end) {
         return path;
     }
     
-    // Dijkstra's algorithm
-    std::map<Node*, double> distances;
-    std::map<Node*, Node*> previous;
-    std::set<Node*> unvisited;
+    if (_mode == SEARCH_BIDIRECTIONAL) {
+        return searchBidirectional(start, end);
+    }
     
-    // Initialize
-    distances[start] = 0.0;
-    unvisited.insert(start);
+    if (!search(start, end)) {
+        return path; // No path found
+    }
     
-    while (!unvisited.empty()) {
-        // Find node with minimum distance
-        Node* current = NULL;
-        double minDist = std::numeric_limits<double>::max();
-        
-        for (std::set<Node*>::iterator it = unvisited.begin(); 
-             it != unvisited.end(); ++it) {
-            double dist = (distances.find(*it) != distances.end()) 
-                         ? distances[*it] 
-                         : std::numeric_limits<double>::max();
-            if (dist < minDist) {
-                minDist = dist;
-                current = *it;
-            }
+    // Reconstruct path
+    for (Node* current = end; current != NULL; current = _prev[current->getId()]) {
+        path.push_back(current);
+        if (current == start) {
+            break;
         }
-        
-        if (current == NULL || minDist == std::numeric_limits<double>::max()) {
-            break; // No path found
+    }
+    std::reverse(path.begin(), path.end());
+    
+    return path;
+}
+
+void DijkstraPathfinding::computeTree(Node* start, size_t nodeCount,
+                                      std::vector<double>& distances,
+                                      std::vector<Node*>& previous) {
+    distances.assign(nodeCount, std::numeric_limits<double>::max());
+    previous.assign(nodeCount, NULL);
+    
+    if (start == NULL) {
+        return;
+    }
+    
+    search(start, NULL);
+    
+    size_t known = std::min(nodeCount, _stamp.size());
+    for (size_t id = 0; id < known; ++id) {
+        if (_stamp[id] == _query) {
+            distances[id] = _dist[id];
+            previous[id] = _prev[id];
         }
-        
-        if (current == end) {
-            break; // Found destination
+    }
+}
+
+std::vector<Node*> DijkstraPathfinding::searchBidirectional(Node* start, Node* end) {
+    std::vector<Node*> path;
+    nextQuery();
+    
+    // Side 0 grows from start, side 1 from end
+    MinHeap heaps[2];
+    
+    ensureCapacity(std::max(start->getId(), end->getId()));
+    _dist[start->getId()] = 0.0;
+    _prev[start->getId()] = NULL;
+    _stamp[start->getId()] = _query;
+    _node[start->getId()] = start;
+    heaps[0].push(HeapEntry(0.0, start->getId()));
+    
+    _distBack[end->getId()] = 0.0;
+    _next[end->getId()] = NULL;
+    _stampBack[end->getId()] = _query;
+    _node[end->getId()] = end;
+    heaps[1].push(HeapEntry(0.0, end->getId()));
+    
+    double best = std::numeric_limits<double>::max();
+    Node* meeting = NULL;
+    
+    while (!heaps[0].empty() && !heaps[1].empty()) {
+        // Any path through unsettled nodes costs at least the two smallest
+        // keys combined, so the best meeting point found so far is optimal
+        if (heaps[0].top().first + heaps[1].top().first >= best) {
+            break;
         }
         
-        unvisited.erase(current);
+        int side = (heaps[0].top().first <= heaps[1].top().first) ? 0 : 1;
+        const std::vector<double>& dist = (side == 0) ? _dist : _distBack;
         
-        // Check neighbors
-        const std::vector<Rail*>& rails = current->getConnectedRails();
-        for (size_t i = 0; i < rails.size(); ++i) {
-            Node* neighbor = rails[i]->getOtherNode(current);
-            if (neighbor == NULL) {
-                continue;
-            }
-            
-            double edgeCost = calculateCost(rails[i]);
-            double currentDist = distances[current];
-            double newDist = currentDist + edgeCost;
-            
-            double neighborDist = (distances.find(neighbor) != distances.end())
-                                 ? distances[neighbor]
-                                 : std::numeric_limits<double>::max();
-            
-            if (newDist < neighborDist) {
-                distances[neighbor] = newDist;
-                previous[neighbor] = current;
-                unvisited.insert(neighbor);
-            }
+        HeapEntry top = heaps[side].top();
+        heaps[side].pop();
+        
+        int currentId = top.second;
+        if (top.first > dist[currentId]) {
+            continue; // Stale entry
         }
+        
+        Node* current = _node[currentId];
+        _settled++;
+        
+        relaxNeighbors(current, top.first, side, heaps[side], &best, &meeting);
     }
     
-    // Reconstruct path
-    if (previous.find(end) == previous.end() && start != end) {
+    if (meeting == NULL) {
         return path; // No path found
     }
     
-    Node* current = end;
-    while (current != NULL) {
-        path.insert(path.begin(), current);
-        if (current == start) {
-            break;
-        }
-        current = (previous.find(current) != previous.end()) 
-                 ? previous[current] 
-                 : NULL;
+    // start .. meeting through the forward tree
+    for (Node* current = meeting; current != NULL; current = _prev[current->getId()]) {
+        path.push_back(current);
+    }
+    std::reverse(path.begin(), path.end());
+    
+    // meeting .. end through the backward tree
+    for (Node* current = _next[meeting->getId()]; current != NULL;
+         current = _next[current->getId()]) {
+        path.push_back(current);
     }
     
     return path;
@@ -0,0 +1,547 @@
+#include "../incl/DiscreteEventEngine.hpp"
+#include "../incl/Rail.hpp"
+#include "../incl/TrainStateStore.hpp"
+#include <algorithm>
+#include <cmath>
+
+const double DiscreteEventEngine::SAFETY_DISTANCE = 2.0;
+
+namespace {
+
+const size_t NO_TRAIN = static_cast<size_t>(-1);
+const double SPEED_EPSILON = 1e-9;      // km/h
+const double DISTANCE_EPSILON = 1e-9;   // km
+const double ARRIVAL_TOLERANCE = 1e-3;  // km, snaps a braking stop to the destination
+const double TIME_EPSILON = 1e-12;      // hours
+const double CURVE_TOLERANCE = 1e-9;    // Relative, a train on remaining == k*v^2
+
+// Trains queued at the same spot: the earlier departure is ahead, as on Rail
+bool departsFirst(const Train* a, const Train* b) {
+    if (a->getDepartureTime() != b->getDepartureTime()) {
+        return a->getDepartureTime() < b->getDepartureTime();
+    }
+    return a->getId() < b->getId();
+}
+
+} // namespace
+
+DiscreteEventEngine::DiscreteEventEngine(const std::vector<Train*>& trains,
+                                         ISubject* subject)
+    : _trains(trains), _sequence(0), _now(0.0), _processed(0), _subject(subject),
+      _scheduler(NULL), _affectsAll(false) {
+    Motion idle;
+    idle.time = 0.0;
+    idle.accel = 0.0;
+    idle.version = 0;
+    idle.active = false;
+    _motion.assign(_trains.size(), idle);
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        _indexOf[_trains[i]] = i;
+    }
+}
+
+DiscreteEventEngine::~DiscreteEventEngine() {
+    // Scheduled events never reached are still owned here
+    while (!_queue.empty()) {
+        delete _queue.top().payload;
+        _queue.pop();
+    }
+}
+
+void DiscreteEventEngine::scheduleEvent(Tick time, IEvent* event) {
+    if (event != NULL) {
+        push(static_cast<double>(time) / TICKS_PER_MINUTE, EVENT_SCHEDULED, NO_TRAIN, event);
+    }
+}
+
+void DiscreteEventEngine::push(double time, EventKind kind, size_t train, IEvent* payload) {
+    Event event;
+    event.time = time;
+    event.sequence = _sequence++;
+    event.kind = kind;
+    event.train = train;
+    event.version = (train != NO_TRAIN) ? _motion[train].version : 0;
+    event.payload = payload;
+    _queue.push(event);
+}
+
+Tick DiscreteEventEngine::toClock(double minute) {
+    return static_cast<Tick>(std::floor(minute * TICKS_PER_MINUTE + 0.5));
+}
+
+double DiscreteEventEngine::firstRoot(double a, double b, double c) {
+    // Smallest t > 0 with a*t^2 + b*t + c = 0, or -1 if there is none
+    if (std::fabs(a) < 1e-12) {
+        if (std::fabs(b) < 1e-15) {
+            return -1.0;
+        }
+        double t = -c / b;
+        return (t > TIME_EPSILON) ? t : -1.0;
+    }
+
+    double disc = b * b - 4.0 * a * c;
+    if (disc < 0.0) {
+        return -1.0;
+    }
+
+    // Numerically stable pair of roots
+    double q = -0.5 * (b + (b >= 0.0 ? std::sqrt(disc) : -std::sqrt(disc)));
+    double t1 = q / a;
+    double t2 = (q != 0.0) ? c / q : t1;
+    if (t1 > t2) {
+        std::swap(t1, t2);
+    }
+    if (t1 > TIME_EPSILON) {
+        return t1;
+    }
+    return (t2 > TIME_EPSILON) ? t2 : -1.0;
+}
+
+void DiscreteEventEngine::settle(size_t index, double time) {
+    Motion& motion = _motion[index];
+    if (!motion.active || time <= motion.time) {
+        return;
+    }
+
+    Train* train = _trains[index];
+    const Position& pos = train->getPosition();
+    double dt = (time - motion.time) / 60.0;
+    double speed = train->getCurrentSpeed();
+
+    // A decelerating train stays put once it reaches zero speed
+    double moving = dt;
+    if (motion.accel < 0.0) {
+        moving = std::min(dt, speed / -motion.accel);
+    }
+    double distance = speed * moving + 0.5 * motion.accel * moving * moving;
+    double newSpeed = std::max(0.0, speed + motion.accel * moving);
+    if (motion.accel > 0.0 && pos.currentRail != NULL) {
+        newSpeed = std::min(newSpeed, pos.currentRail->getSpeedLimit());
+    }
+
+    // Rail changes only happen on EVENT_RAIL_END
+    if (pos.currentRail != NULL) {
+        double railLeft = pos.currentRail->getLength() - pos.distanceOnRail;
+        distance = std::min(distance, std::max(0.0, railLeft - DISTANCE_EPSILON));
+    }
+
+    train->advance(std::max(0.0, distance));
+    train->setCurrentSpeed(newSpeed);
+    train->setCurrentTime(toClock(time));
+    motion.time = time;
+}
+
+void DiscreteEventEngine::settleRail(const Rail* rail, double time) {
+    if (rail == NULL) {
+        return;
+    }
+    const std::vector<Train*>& occupants = rail->getOccupyingTrains();
+    for (size_t i = 0; i < occupants.size(); ++i) {
+        settle(indexOf(occupants[i]), time);
+    }
+}
+
+size_t DiscreteEventEngine::indexOf(const Train* train) const {
+    std::map<const Train*, size_t>::const_iterator it = _indexOf.find(train);
+    return (it != _indexOf.end()) ? it->second : NO_TRAIN;
+}
+
+size_t DiscreteEventEngine::findNeighbor(size_t index, bool ahead) const {
+    // Closest moving train on the same rail and in the same direction
+    const Position& pos = _trains[index]->getPosition();
+    if (pos.currentRail == NULL) {
+        return NO_TRAIN;
+    }
+
+    const std::vector<Train*>& occupants = pos.currentRail->getOccupyingTrains();
+    size_t neighbor = NO_TRAIN;
+    double best = 0.0;
+
+    for (size_t i = 0; i < occupants.size(); ++i) {
+        size_t j = indexOf(occupants[i]);
+        if (j == index || j == NO_TRAIN || !_motion[j].active) {
+            continue;
+        }
+        const Position& other = occupants[i]->getPosition();
+        if (other.currentRail != pos.currentRail || other.lastNode != pos.lastNode) {
+            continue;
+        }
+        double gap = ahead ? other.distanceOnRail - pos.distanceOnRail
+                           : pos.distanceOnRail - other.distanceOnRail;
+        if (gap == 0.0 && departsFirst(occupants[i], _trains[index]) != ahead) {
+            continue;
+        }
+        if (gap >= 0.0 && (neighbor == NO_TRAIN || gap < best)) {
+            neighbor = j;
+            best = gap;
+        }
+    }
+    return neighbor;
+}
+
+void DiscreteEventEngine::replan(size_t index) {
+    Motion& motion = _motion[index];
+    motion.version++; // Drops the pending motion event
+    if (!motion.active) {
+        return;
+    }
+
+    Train* train = _trains[index];
+    const Position& pos = train->getPosition();
+    settleRail(pos.currentRail, _now);
+    settle(index, _now);
+    motion.time = _now;
+
+    if (pos.currentRail == NULL) {
+        return;
+    }
+
+    // Held by a DelayEvent: stand still until the hold ends
+    Tick holdUntil = train->getHoldUntil();
+    if (holdUntil > toClock(_now)) {
+        motion.accel = 0.0;
+        train->setCurrentSpeed(0.0);
+        train->setState(STATE_WAITING);
+        push(static_cast<double>(holdUntil) / TICKS_PER_MINUTE, EVENT_RESUME, index, NULL);
+        return;
+    }
+
+    double limit = pos.currentRail->getSpeedLimit();
+    double speed = std::min(train->getCurrentSpeed(), limit);
+    double braking = train->calculateBraking();
+    double toGo = train->getTotalDistanceToGo();
+    double railLeft = pos.currentRail->getLength() - pos.distanceOnRail;
+    train->setCurrentSpeed(speed);
+
+    if (toGo <= DISTANCE_EPSILON) {
+        motion.accel = 0.0;
+        push(_now, EVENT_STOP, index, NULL);
+        return;
+    }
+
+    // Own profile, the fixed-step rule of TrainStateStore in closed form
+    // (as KinematicProfile): accelerate below the cruise share of the
+    // limit, hold above it, and brake once the rail end is within both
+    // BRAKING_ZONE and the stopping distance k*v^2. On the curve
+    // remaining == k*v^2 the stepped train alternates between braking and
+    // holding, which averages to braking / 3.6 and stops at the rail end.
+    const double zone = TrainStateStore::BRAKING_ZONE;
+    const double cruise = limit * TrainStateStore::CRUISE_FRACTION;
+    const bool canBrake = braking > 0.0;
+    const double k = canBrake ? TrainStateStore::stoppingDistance(1.0, braking) : 0.0;
+    double curve = k * speed * speed;
+    bool pastZone = railLeft < zone + DISTANCE_EPSILON;
+    bool inZone = canBrake && pastZone && railLeft < curve * (1.0 + CURVE_TOLERANCE);
+    bool sliding = inZone && railLeft > curve * (1.0 - CURVE_TOLERANCE);
+
+    double accel = 0.0;
+    if (sliding) {
+        accel = -braking / 3.6;
+    } else if (inZone) {
+        accel = -braking;
+    } else if (speed < cruise - SPEED_EPSILON) {
+        accel = train->calculateTractiveAcceleration();
+    }
+
+    // Headway, the brake-ahead rule of the fixed step: within the safety
+    // distance of the train ahead, brake (or keep waiting) until it opens
+    size_t leader = findNeighbor(index, true);
+    bool brakeAhead = false;
+    double gap = 0.0;
+    double leaderSpeed = 0.0;
+    double leaderAccel = 0.0;
+    if (leader != NO_TRAIN) {
+        gap = _trains[leader]->getPosition().distanceOnRail - pos.distanceOnRail;
+        leaderSpeed = _trains[leader]->getCurrentSpeed();
+        leaderAccel = _motion[leader].accel;
+        bool closing = speed > leaderSpeed + SPEED_EPSILON ||
+                       (speed > leaderSpeed - SPEED_EPSILON && accel > leaderAccel);
+        if (gap < SAFETY_DISTANCE - DISTANCE_EPSILON ||
+            (gap <= SAFETY_DISTANCE + DISTANCE_EPSILON && closing)) {
+            brakeAhead = true;
+            inZone = false;
+            sliding = false;
+            accel = (speed > SPEED_EPSILON) ? -braking : 0.0;
+        }
+    }
+    motion.accel = accel;
+
+    if (accel < 0.0) {
+        train->setState(STATE_BRAKING);
+    } else if (speed <= SPEED_EPSILON && accel <= 0.0) {
+        train->setState(STATE_WAITING);
+    } else if (accel > 0.0) {
+        train->setState(STATE_ACCELERATING);
+    } else {
+        train->setState(STATE_MAINTAINING);
+    }
+
+    // Earliest change in the motion; times in hours from now
+    double next = -1.0;
+    EventKind kind = EVENT_RAIL_END;
+
+    double t = firstRoot(0.5 * accel, speed, -railLeft);
+    if (t > 0.0) {
+        next = t;
+        kind = EVENT_RAIL_END;
+    }
+    if (sliding) {
+        // Zero speed right at the rail end; the root above is a double one
+        next = speed / -accel;
+        kind = EVENT_RAIL_END;
+    } else if (accel > 0.0) {
+        t = (cruise - speed) / accel;
+        if (t > TIME_EPSILON && (next < 0.0 || t < next)) {
+            next = t;
+            kind = EVENT_SPEED_REACHED;
+        }
+    }
+    if (accel < 0.0 && !sliding) {
+        t = speed / -accel;
+        if (t > TIME_EPSILON && (next < 0.0 || t < next)) {
+            next = t;
+            kind = EVENT_STOP;
+        }
+    }
+    if (canBrake && !sliding && !brakeAhead) {
+        // Braking point: remaining == k*v^2 (entering or leaving the curve),
+        // and for a free train also remaining == BRAKING_ZONE
+        double tCurve = (!inZone && railLeft < curve) ? 0.0
+                      : firstRoot(k * accel * accel + 0.5 * accel,
+                                  2.0 * k * speed * accel + speed, curve - railLeft);
+        double tZone = pastZone ? 0.0 : firstRoot(0.5 * accel, speed, zone - railLeft);
+        t = inZone ? tCurve : ((tCurve >= 0.0 && tZone >= 0.0) ? std::max(tCurve, tZone) : -1.0);
+        if (t > TIME_EPSILON && (next < 0.0 || t < next)) {
+            next = t;
+            kind = EVENT_BRAKE_ONSET;
+        }
+    }
+    if (leader != NO_TRAIN) {
+        // The gap crossing the safety distance, closing or opening
+        t = firstRoot(0.5 * (leaderAccel - accel), leaderSpeed - speed, gap - SAFETY_DISTANCE);
+        if (t > TIME_EPSILON && (next < 0.0 || t < next)) {
+            next = t;
+            kind = EVENT_HEADWAY;
+        }
+    }
+
+    if (next >= 0.0) {
+        push(_now + next * 60.0, kind, index, NULL);
+    }
+}
+
+void DiscreteEventEngine::replanAll() {
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        replan(i);
+    }
+}
+
+void DiscreteEventEngine::routeChanged(const Train* train) {
+    size_t index = indexOf(train);
+    if (index != NO_TRAIN) {
+        _rerouted.push_back(index);
+    }
+}
+
+void DiscreteEventEngine::beforeEvent(const IEvent* event) {
+    // Bring the event's trains up to date under the old limits; several
+    // events due at once add up until afterEvent()
+    if (_affectsAll) {
+        return;
+    }
+    const Train* train = event->getTrain();
+    const Rail* rail = event->getRail();
+    if (train != NULL) {
+        size_t index = indexOf(train);
+        if (index != NO_TRAIN) {
+            _affected.push_back(index);
+            settle(index, _now);
+        }
+    } else if (rail != NULL) {
+        const std::vector<Train*>& occupants = rail->getOccupyingTrains();
+        for (size_t i = 0; i < occupants.size(); ++i) {
+            size_t index = indexOf(occupants[i]);
+            if (index != NO_TRAIN) {
+                _affected.push_back(index);
+            }
+        }
+        settleRail(rail, _now);
+    } else {
+        _affectsAll = true;
+        for (size_t i = 0; i < _trains.size(); ++i) {
+            settle(i, _now);
+        }
+    }
+}
+
+void DiscreteEventEngine::afterEvent() {
+    if (_affectsAll) {
+        _affectsAll = false;
+        _affected.clear();
+        _rerouted.clear();
+        replanAll();
+        return;
+    }
+    
+    // Re-routed trains keep their rail, not their distance to go
+    _affected.insert(_affected.end(), _rerouted.begin(), _rerouted.end());
+    _rerouted.clear();
+    std::sort(_affected.begin(), _affected.end());
+    _affected.erase(std::unique(_affected.begin(), _affected.end()), _affected.end());
+    
+    // Same train order as a full re-plan, then the trains behind each one
+    for (size_t k = 0; k < _affected.size(); ++k) {
+        replan(_affected[k]);
+    }
+    for (size_t k = 0; k < _affected.size(); ++k) {
+        replanFollowers(_affected[k]);
+    }
+    _affected.clear();
+}
+
+void DiscreteEventEngine::replanFollowers(size_t index) {
+    // Each re-planned follower changes the headway of the one behind it
+    size_t current = index;
+    for (size_t guard = 0; guard < _trains.size(); ++guard) {
+        settleRail(_trains[current]->getPosition().currentRail, _now);
+        size_t follower = findNeighbor(current, false);
+        if (follower == NO_TRAIN) {
+            break;
+        }
+        replan(follower);
+        current = follower;
+    }
+}
+
+void DiscreteEventEngine::arrive(size_t index) {
+    Motion& motion = _motion[index];
+    motion.active = false;
+    motion.accel = 0.0;
+    motion.version++;
+
+    Train* train = _trains[index];
+    train->setState(STATE_STOPPED);
+    train->setCurrentSpeed(0.0);
+    train->setCurrentTime(toClock(_now));
+
+    if (_subject != NULL) {
+        _subject->notify("ARRIVAL: " + train->getName() + " at " + formatClock(toClock(_now)));
+    }
+}
+
+Tick DiscreteEventEngine::run(Tick start, size_t maxEvents) {
+    double startMinute = static_cast<double>(start) / TICKS_PER_MINUTE;
+    _now = startMinute;
+    size_t remaining = 0;
+
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        Train* train = _trains[i];
+        if (train->getPosition().currentRail == NULL || train->hasArrived()) {
+            continue; // No route, nothing to simulate
+        }
+        remaining++;
+        double departure = std::max(startMinute,
+                                    static_cast<double>(train->getDepartureTime()) / TICKS_PER_MINUTE);
+        push(departure, EVENT_DEPARTURE, i, NULL);
+    }
+
+    while (remaining > 0 && _processed < maxEvents) {
+        bool scheduled = (_scheduler != NULL && !_scheduler->empty());
+        if (_queue.empty() && !scheduled) {
+            break;
+        }
+
+        // Timed scheduler entries due before the next engine event
+        if (scheduled && (_queue.empty() ||
+                          _scheduler->nextTime() <= toClock(_queue.top().time))) {
+            Tick due = _scheduler->nextTime();
+            _now = std::max(_now, static_cast<double>(due) / TICKS_PER_MINUTE);
+            _processed++;
+
+            while (!_scheduler->empty() && _scheduler->nextTime() <= due) {
+                beforeEvent(_scheduler->nextEvent());
+                _scheduler->processNext(_subject);
+            }
+            afterEvent();
+            continue;
+        }
+
+        Event event = _queue.top();
+        _queue.pop();
+
+        if (event.kind != EVENT_SCHEDULED && event.kind != EVENT_DEPARTURE &&
+            event.version != _motion[event.train].version) {
+            continue; // Superseded by a later re-plan
+        }
+
+        _now = event.time;
+        _processed++;
+
+        if (event.kind == EVENT_SCHEDULED) {
+            beforeEvent(event.payload);
+            event.payload->execute();
+            if (_subject != NULL) {
+                _subject->notify(event.payload->getDescription());
+            }
+            delete event.payload;
+            afterEvent();
+            continue;
+        }
+
+        size_t index = event.train;
+        Train* train = _trains[index];
+
+        if (event.kind == EVENT_DEPARTURE) {
+            if (_motion[index].active) {
+                continue; // Already running
+            }
+            // Departure postponed by a DelayEvent
+            double departure = static_cast<double>(train->getDepartureTime()) / TICKS_PER_MINUTE;
+            if (departure > _now) {
+                push(departure, EVENT_DEPARTURE, index, NULL);
+                continue;
+            }
+            _motion[index].active = true;
+            _motion[index].time = _now;
+            train->setState(STATE_ACCELERATING);
+            train->setCurrentTime(toClock(_now));
+            replan(index);
+            continue;
+        }
+
+        const Rail* rail = train->getPosition().currentRail;
+        settleRail(rail, _now);
+        settle(index, _now);
+
+        double railLeft = rail->getLength() - train->getPosition().distanceOnRail;
+        bool atEnd = (event.kind == EVENT_RAIL_END) ||
+                     (event.kind == EVENT_STOP &&
+                      train->getTotalDistanceToGo() <= ARRIVAL_TOLERANCE);
+
+        if (!atEnd) {
+            replan(index);
+            replanFollowers(index);
+            continue;
+        }
+
+        // Leaving the rail: trains behind lose their leader
+        size_t follower = findNeighbor(index, false);
+        train->advance(railLeft);
+
+        if (train->hasArrived()) {
+            arrive(index);
+            remaining--;
+        } else {
+            replan(index);
+        }
+        if (follower != NO_TRAIN) {
+            replan(follower);
+            replanFollowers(follower);
+        }
+    }
+
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        settle(i, _now);
+    }
+    return toClock(_now);
+}
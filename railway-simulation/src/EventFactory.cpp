@@ -1,9 +1,44 @@
 #include "../incl/EventFactory.hpp"
+#include "../incl/RailwayNetwork.hpp"
+#include "../incl/BinaryIO.hpp"
 #include <sstream>
 
+namespace {
+
+// Kind tags of saved events
+const int SAVED_DELAY = 1;
+const int SAVED_SPEED_REDUCTION = 2;
+
+// One-off stream keyed by the global rand(), so srand() still decides
+// the events of the overloads without a stream
+RandomStream streamFromRand() {
+    return RandomStream(static_cast<unsigned long long>(rand()), 0);
+}
+
+} // namespace
+
 // DelayEvent implementation
 void DelayEvent::execute() {
-    // Delay is applied in simulation manager
+    if (_train == NULL || _train->hasArrived()) {
+        return;
+    }
+    
+    Tick delay = _delayMinutes * TICKS_PER_MINUTE;
+    if (_train->getState() == STATE_STOPPED && _train->isAtStation()) {
+        _train->delayDeparture(delay);
+    } else {
+        _train->holdFor(delay);
+    }
+}
+
+bool DelayEvent::save(std::ostream& out) const {
+    if (_train == NULL) {
+        return false;
+    }
+    writeBinary(out, SAVED_DELAY);
+    writeBinary(out, _train->getId());
+    writeBinary(out, _delayMinutes);
+    return true;
 }
 
 std::string DelayEvent::getDescription() const {
@@ -14,7 +49,31 @@ std::string DelayEvent::getDescription() const {
 
 // SpeedReductionEvent implementation
 void SpeedReductionEvent::execute() {
-    // Speed reduction would modify rail speed limit temporarily
+    double factor = 1.0 - _reductionPercent / 100.0;
+    if (_network != NULL) {
+        _network->addSpeedRestriction(_rail, factor);
+    } else if (_rail != NULL) {
+        _rail->addSpeedRestriction(factor);
+    }
+}
+
+void SpeedReductionEvent::expire() {
+    double factor = 1.0 - _reductionPercent / 100.0;
+    if (_network != NULL) {
+        _network->removeSpeedRestriction(_rail, factor);
+    } else if (_rail != NULL) {
+        _rail->removeSpeedRestriction(factor);
+    }
+}
+
+bool SpeedReductionEvent::save(std::ostream& out) const {
+    if (_rail == NULL) {
+        return false;
+    }
+    writeBinary(out, SAVED_SPEED_REDUCTION);
+    writeBinary(out, _rail->getId());
+    writeBinary(out, _reductionPercent);
+    return true;
 }
 
 std::string SpeedReductionEvent::getDescription() const {
@@ -25,30 +84,71 @@ std::string SpeedReductionEvent::getDescription() const {
 
 // EventFactory implementation
 IEvent* EventFactory::createRandomEvent(Train* train) {
+    RandomStream random = streamFromRand();
+    return createRandomEvent(train, random);
+}
+
+IEvent* EventFactory::createRandomEvent(Rail* rail) {
+    RandomStream random = streamFromRand();
+    return createRandomEvent(rail, random);
+}
+
+IEvent* EventFactory::createRandomEvent(Train* train, RandomStream& random) {
     if (train == NULL) {
         return NULL;
     }
     
-    int eventType = rand() % 2;
+    int eventType = random.nextInt(2);
     
     switch (eventType) {
         case 0:
-            return new DelayEvent(train, 5 + (rand() % 20)); // 5-25 min delay
+            return new DelayEvent(train, 5 + random.nextInt(20)); // 5-25 min delay
         default:
             return NULL;
     }
 }
 
-IEvent* EventFactory::createRandomEvent(Rail* rail) {
+IEvent* EventFactory::createRandomEvent(Rail* rail, RandomStream& random,
+                                        RailwayNetwork* network) {
     if (rail == NULL) {
         return NULL;
     }
     
-    int eventType = rand() % 2;
+    int eventType = random.nextInt(2);
     
     switch (eventType) {
         case 0:
-            return new SpeedReductionEvent(rail, 10.0 + (rand() % 30)); // 10-40% reduction
+            return new SpeedReductionEvent(rail, 10.0 + random.nextInt(30), network); // 10-40% reduction
+        default:
+            return NULL;
+    }
+}
+
+IEvent* EventFactory::readEvent(std::istream& in, RailwayNetwork* network,
+                                const std::vector<Train*>& trains) {
+    int kind = 0;
+    int id = 0;
+    if (!readBinary(in, kind) || !readBinary(in, id)) {
+        return NULL;
+    }
+    
+    switch (kind) {
+        case SAVED_DELAY: {
+            int delayMinutes = 0;
+            if (!readBinary(in, delayMinutes) || id < 1 ||
+                static_cast<size_t>(id) > trains.size()) {
+                return NULL;
+            }
+            return new DelayEvent(trains[id - 1], delayMinutes);
+        }
+        case SAVED_SPEED_REDUCTION: {
+            double reductionPercent = 0.0;
+            if (!readBinary(in, reductionPercent) || network == NULL || id < 0 ||
+                static_cast<size_t>(id) >= network->getRails().size()) {
+                return NULL;
+            }
+            return new SpeedReductionEvent(network->getRails()[id], reductionPercent, network);
+        }
         default:
             return NULL;
     }
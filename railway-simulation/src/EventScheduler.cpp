@@ -0,0 +1,172 @@
+#include "../incl/EventScheduler.hpp"
+#include "../incl/EventFactory.hpp"
+#include "../incl/BinaryIO.hpp"
+#include <algorithm>
+#include <map>
+
+EventScheduler::EventScheduler() : _sequence(0) {
+}
+
+EventScheduler::~EventScheduler() {
+    clear();
+}
+
+void EventScheduler::schedule(IEvent* event, Tick start, Tick end) {
+    if (event == NULL) {
+        return;
+    }
+    
+    bool timed = (end >= start);
+    push(start, false, !timed, false, event);
+    if (timed) {
+        // Queued after the start, so an empty window still runs it first
+        push(end, true, true, end == start, event);
+    }
+}
+
+void EventScheduler::push(Tick time, bool end, bool last, bool empty, IEvent* event) {
+    Entry entry;
+    entry.time = time;
+    entry.sequence = _sequence++;
+    entry.end = end;
+    entry.last = last;
+    entry.empty = empty;
+    entry.event = event;
+    
+    _heap.push_back(entry);
+    std::push_heap(_heap.begin(), _heap.end(), Later());
+}
+
+size_t EventScheduler::processUntil(Tick time, ISubject* subject) {
+    size_t processed = 0;
+    
+    while (!_heap.empty() && _heap.front().time <= time) {
+        processNext(subject);
+        processed++;
+    }
+    return processed;
+}
+
+void EventScheduler::processNext(ISubject* subject) {
+    std::pop_heap(_heap.begin(), _heap.end(), Later());
+    Entry entry = _heap.back();
+    _heap.pop_back();
+    
+    if (entry.end) {
+        entry.event->expire();
+    } else {
+        entry.event->execute();
+    }
+    if (subject != NULL) {
+        subject->notify((entry.end ? "EVENT ENDED: " : "EVENT: ") +
+                        entry.event->getDescription());
+    }
+    if (entry.last) {
+        delete entry.event;
+    }
+}
+
+void EventScheduler::clear() {
+    // A timed event is deleted with its end entry only
+    for (size_t i = 0; i < _heap.size(); ++i) {
+        if (_heap[i].last) {
+            delete _heap[i].event;
+        }
+    }
+    _heap.clear();
+}
+
+void EventScheduler::swap(EventScheduler& other) {
+    _heap.swap(other._heap);
+    std::swap(_sequence, other._sequence);
+}
+
+bool EventScheduler::save(std::ostream& out) const {
+    // A timed event has two entries but is written once
+    std::map<const IEvent*, unsigned int> indexOf;
+    std::vector<const IEvent*> events;
+    for (size_t i = 0; i < _heap.size(); ++i) {
+        if (indexOf.insert(std::make_pair(_heap[i].event,
+                                          static_cast<unsigned int>(events.size()))).second) {
+            events.push_back(_heap[i].event);
+        }
+    }
+    
+    writeBinary(out, _sequence);
+    writeBinary(out, static_cast<unsigned int>(events.size()));
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (!events[i]->save(out)) {
+            return false;
+        }
+    }
+    
+    writeBinary(out, static_cast<unsigned int>(_heap.size()));
+    for (size_t i = 0; i < _heap.size(); ++i) {
+        writeBinary(out, _heap[i].time);
+        writeBinary(out, _heap[i].sequence);
+        writeBinary(out, static_cast<unsigned char>(_heap[i].end));
+        writeBinary(out, static_cast<unsigned char>(_heap[i].last));
+        writeBinary(out, static_cast<unsigned char>(_heap[i].empty));
+        writeBinary(out, indexOf[_heap[i].event]);
+    }
+    return out.good();
+}
+
+bool EventScheduler::restore(std::istream& in, RailwayNetwork* network,
+                             const std::vector<Train*>& trains) {
+    clear();
+    
+    unsigned long sequence = 0;
+    unsigned int eventCount = 0;
+    if (!readBinary(in, sequence) || !readBinary(in, eventCount)) {
+        return false;
+    }
+    
+    // Until they are in the heap, the events are owned here
+    std::vector<IEvent*> events;
+    bool ok = true;
+    for (unsigned int i = 0; i < eventCount && ok; ++i) {
+        IEvent* event = EventFactory::readEvent(in, network, trains);
+        ok = (event != NULL);
+        if (ok) {
+            events.push_back(event);
+        }
+    }
+    
+    // Every event must be deleted by exactly one (last) entry
+    std::vector<bool> owned(events.size(), false);
+    unsigned int entryCount = 0;
+    ok = ok && readBinary(in, entryCount) && entryCount <= 2 * eventCount;
+    for (unsigned int i = 0; i < entryCount && ok; ++i) {
+        Entry entry;
+        unsigned char end = 0;
+        unsigned char last = 0;
+        unsigned char empty = 0;
+        unsigned int index = 0;
+        ok = readBinary(in, entry.time) && readBinary(in, entry.sequence) &&
+             readBinary(in, end) && readBinary(in, last) && readBinary(in, empty) &&
+             readBinary(in, index) && index < events.size() &&
+             !(last != 0 && owned[index]) && !(empty != 0 && end == 0);
+        if (ok) {
+            entry.end = (end != 0);
+            entry.last = (last != 0);
+            entry.empty = (empty != 0);
+            entry.event = events[index];
+            owned[index] = owned[index] || entry.last;
+            _heap.push_back(entry);
+        }
+    }
+    for (size_t i = 0; i < owned.size() && ok; ++i) {
+        ok = owned[i];
+    }
+    
+    if (!ok) {
+        _heap.clear();
+        for (size_t i = 0; i < events.size(); ++i) {
+            delete events[i];
+        }
+        return false;
+    }
+    _sequence = sequence;
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "../incl/InputParser.hpp"
+#include "../incl/EventFactory.hpp"
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
@@ -77,7 +78,8 @@ std::vector<Train*> InputParser::parseTrainsFile(const std::string& filename,
             }
             
             Train* train = new Train(name, weight, friction, maxAccel, maxBrake,
-                                    departure, destination, depTime, stopDuration);
+                                    departure, destination, depTime.toTicks(),
+                                    stopDuration.toTicks());
             trains.push_back(train);
             
         } catch (const std::exception& e) {
@@ -93,8 +95,106 @@ std::vector<Train*> InputParser::parseTrainsFile(const std::string& filename,
     return trains;
 }
 
+std::vector<ScheduledEvent> InputParser::parseEventsFile(const std::string& filename,
+                                                         RailwayNetwork* network,
+                                                         const std::vector<Train*>& trains) {
+    std::vector<ScheduledEvent> events;
+    
+    if (network == NULL) {
+        std::cerr << "ERROR: Network is NULL" << std::endl;
+        return events;
+    }
+    
+    std::ifstream file(filename.c_str());
+    if (!file.is_open()) {
+        std::cerr << "ERROR: Cannot open events file: " << filename << std::endl;
+        return events;
+    }
+    
+    std::string line;
+    int lineNum = 0;
+    
+    while (std::getline(file, line)) {
+        lineNum++;
+        trim(line);
+        
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        
+        std::vector<std::string> tokens = split(line, ' ');
+        
+        try {
+            if (tokens[0] == "Delay") {
+                if (tokens.size() != 4) {
+                    throw std::runtime_error("Delay requires exactly 3 arguments");
+                }
+                
+                Train* train = NULL;
+                for (size_t i = 0; i < trains.size(); ++i) {
+                    if (trains[i]->getName() == tokens[1]) {
+                        train = trains[i];
+                        break;
+                    }
+                }
+                if (train == NULL) {
+                    throw std::runtime_error("Unknown train: " + tokens[1]);
+                }
+                
+                Time start = parseTime(tokens[2]);
+                if (!isValidNumber(tokens[3]) || atoi(tokens[3].c_str()) <= 0) {
+                    throw std::runtime_error("Delay must be a positive number of minutes");
+                }
+                
+                events.push_back(ScheduledEvent(new DelayEvent(train, atoi(tokens[3].c_str())),
+                                                start.toTicks(), -1));
+                
+            } else if (tokens[0] == "SpeedReduction") {
+                if (tokens.size() != 6) {
+                    throw std::runtime_error("SpeedReduction requires exactly 5 arguments");
+                }
+                
+                Node* from = network->getNode(tokens[1]);
+                Node* to = network->getNode(tokens[2]);
+                Rail* rail = (from != NULL && to != NULL) ? from->getRailTo(to) : NULL;
+                if (rail == NULL) {
+                    throw std::runtime_error("No rail between " + tokens[1] + " and " + tokens[2]);
+                }
+                
+                Time start = parseTime(tokens[3]);
+                Time end = parseTime(tokens[4]);
+                if (end.toTicks() <= start.toTicks()) {
+                    throw std::runtime_error("End time must be after start time");
+                }
+                
+                double percent = atof(tokens[5].c_str());
+                if (!isValidNumber(tokens[5]) || percent <= 0 || percent > 100) {
+                    throw std::runtime_error("Reduction must be between 0 and 100 percent");
+                }
+                
+                events.push_back(ScheduledEvent(new SpeedReductionEvent(rail, percent, network),
+                                                start.toTicks(), end.toTicks()));
+                
+            } else {
+                throw std::runtime_error("Unknown command: " + tokens[0]);
+            }
+            
+        } catch (const std::exception& e) {
+            std::cerr << "ERROR at line " << lineNum << ": " << e.what() << std::endl;
+            std::cerr << "Line: " << line << std::endl;
+        }
+    }
+    
+    file.close();
+    
+    std::cout << "Events loaded: " << events.size() << std::endl;
+    
+    return events;
+}
+
 void InputParser::printUsage() {
-    std::cout << "Usage: ./railway_simulation <network_file> <trains_file>" << std::endl;
+    std::cout << "Usage: ./railway_simulation <network_file> <trains_file> [events_file] [--stream <records>] [--threads <count>]" << std::endl;
+    std::cout << "   or: ./railway_simulation <network_file> <trains_file> --monte-carlo <runs> [seed] [--threads <count>]" << std::endl;
     std::cout << "   or: ./railway_simulation --help" << std::endl;
 }
 
@@ -102,7 +202,20 @@ void InputParser::printHelp() {
     std::cout << "=== Railway Simulation Help ===" << std::endl << std::endl;
     
     std::cout << "USAGE:" << std::endl;
-    std::cout << "  ./railway_simulation <network_file> <trains_file>" << std::endl << std::endl;
+    std::cout << "  ./railway_simulation <network_file> <trains_file> [events_file] [--stream <records>] [--threads <count>]" << std::endl;
+    std::cout << "  ./railway_simulation <network_file> <trains_file> --monte-carlo <runs> [seed] [--threads <count>]" << std::endl << std::endl;
+    
+    std::cout << "  --stream keeps at most <records> trace rows per train in memory and" << std::endl;
+    std::cout << "  appends them to the result file as each window fills." << std::endl << std::endl;
+    
+    std::cout << "  --threads computes routes and train steps on <count> threads (default 1," << std::endl;
+    std::cout << "  0 = every core); the results do not depend on it. With --monte-carlo it" << std::endl;
+    std::cout << "  sets the threads running the replications (default every core)." << std::endl << std::endl;
+    
+    std::cout << "  --monte-carlo runs the scenario <runs> times with random train delays" << std::endl;
+    std::cout << "  and rail speed reductions at random times, and prints the arrival delay" << std::endl;
+    std::cout << "  distribution of each train. <runs> and [seed] are unsigned integers;" << std::endl;
+    std::cout << "  the same seed (default 1) gives the same results." << std::endl << std::endl;
     
     std::cout << "NETWORK FILE FORMAT:" << std::endl;
     std::cout << "  Node <NodeName>" << std::endl;
@@ -139,6 +252,17 @@ void InputParser::printHelp() {
     std::cout << "    TrainAB 80 0.05 356.0 30.0 CityA CityB 14h10 00h10" << std::endl;
     std::cout << "    TrainAC 60 0.05 412.0 40.0 CityA CityC 14h20 00h10" << std::endl << std::endl;
     
+    std::cout << "EVENTS FILE FORMAT (optional):" << std::endl;
+    std::cout << "  Delay <Train> <Time> <Minutes>" << std::endl;
+    std::cout << "    - Postpones a waiting train's departure, or holds a running train" << std::endl;
+    std::cout << "  SpeedReduction <Node> <Node> <Start> <End> <Percent>" << std::endl;
+    std::cout << "    - Lowers the rail's speed limit between Start and End (HHhMM)" << std::endl;
+    std::cout << "    - 100 percent closes the rail; trains re-route around it if they can" << std::endl << std::endl;
+    
+    std::cout << "  Example events file:" << std::endl;
+    std::cout << "    Delay TrainAB 15h00 15" << std::endl;
+    std::cout << "    SpeedReduction RailNodeA RailNodeB 14h30 15h30 50" << std::endl << std::endl;
+    
     std::cout << "OUTPUT:" << std::endl;
     std::cout << "  For each train, a file named <TrainName>_<DepartureTime>.result" << std::endl;
     std::cout << "  will be created containing the simulation results." << std::endl << std::endl;
@@ -0,0 +1,280 @@
+#include "../incl/KinematicProfile.hpp"
+#include "../incl/Train.hpp"
+#include "../incl/BinaryIO.hpp"
+#include "../incl/TrainStateStore.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double SPEED_EPSILON = 1e-9;      // km/h
+const double DISTANCE_EPSILON = 1e-9;   // km
+const double TIME_EPSILON = 1e-12;      // hours
+
+} // namespace
+
+KinematicProfile::KinematicProfile()
+    : _startOffset(0.0), _endOffset(0.0), _duration(0.0), _stalled(false) {
+}
+
+void KinematicProfile::clear() {
+    _phases.clear();
+    _railExitTimes.clear();
+    _startOffset = 0.0;
+    _endOffset = 0.0;
+    _duration = 0.0;
+    _stalled = false;
+}
+
+void KinematicProfile::save(std::ostream& out) const {
+    writeBinary(out, static_cast<unsigned int>(_phases.size()));
+    for (size_t i = 0; i < _phases.size(); ++i) {
+        writeBinary(out, _phases[i].startTime);
+        writeBinary(out, _phases[i].startOffset);
+        writeBinary(out, _phases[i].startSpeed);
+        writeBinary(out, _phases[i].accel);
+        writeBinary(out, static_cast<int>(_phases[i].state));
+    }
+    writeBinaryVector(out, _railExitTimes);
+    writeBinary(out, _startOffset);
+    writeBinary(out, _endOffset);
+    writeBinary(out, _duration);
+    writeBinary(out, static_cast<unsigned char>(_stalled));
+}
+
+bool KinematicProfile::restore(std::istream& in) {
+    clear();
+    
+    const unsigned int maxPhases = 1u << 24;
+    unsigned int phaseCount = 0;
+    if (!readBinary(in, phaseCount) || phaseCount > maxPhases) {
+        return false;
+    }
+    for (unsigned int i = 0; i < phaseCount; ++i) {
+        Phase phase;
+        int state = 0;
+        if (!readBinary(in, phase.startTime) || !readBinary(in, phase.startOffset) ||
+            !readBinary(in, phase.startSpeed) || !readBinary(in, phase.accel) ||
+            !readBinary(in, state) || !isTrainState(state)) {
+            clear();
+            return false;
+        }
+        phase.state = static_cast<TrainState>(state);
+        _phases.push_back(phase);
+    }
+    
+    unsigned char stalled = 0;
+    if (!readBinaryVector(in, _railExitTimes, maxPhases) ||
+        !readBinary(in, _startOffset) || !readBinary(in, _endOffset) ||
+        !readBinary(in, _duration) || !readBinary(in, stalled)) {
+        clear();
+        return false;
+    }
+    _stalled = (stalled != 0);
+    return true;
+}
+
+void KinematicProfile::addPhase(double time, double offset, double speed,
+                                double accel, TrainState state) {
+    Phase phase;
+    phase.startTime = time;
+    phase.startOffset = offset;
+    phase.startSpeed = speed;
+    phase.accel = accel;
+    phase.state = state;
+    _phases.push_back(phase);
+}
+
+double KinematicProfile::firstRoot(double a, double b, double c) {
+    // Smallest t > 0 with a*t^2 + b*t + c = 0, or -1 if there is none
+    if (std::fabs(a) < 1e-12) {
+        if (std::fabs(b) < 1e-15) {
+            return -1.0;
+        }
+        double t = -c / b;
+        return (t > TIME_EPSILON) ? t : -1.0;
+    }
+    double disc = b * b - 4.0 * a * c;
+    if (disc < 0.0) {
+        return -1.0;
+    }
+    double q = -0.5 * (b + (b >= 0.0 ? std::sqrt(disc) : -std::sqrt(disc)));
+    double t1 = q / a;
+    double t2 = (q != 0.0) ? c / q : t1;
+    if (t1 > t2) {
+        std::swap(t1, t2);
+    }
+    if (t1 > TIME_EPSILON) {
+        return t1;
+    }
+    return (t2 > TIME_EPSILON) ? t2 : -1.0;
+}
+
+void KinematicProfile::build(const Train& train) {
+    clear();
+    _startOffset = train.getDistanceTravelled();
+    _endOffset = _startOffset;
+
+    // The train cannot get past a hop without a rail
+    size_t first = train.getCurrentPathIndex();
+    size_t last = first;
+    while (last < train.getSegmentCount() && train.getSegmentRail(last) != NULL) {
+        last++;
+    }
+    if (first >= last) {
+        return;
+    }
+
+    double accel = train.calculateTractiveAcceleration();
+    double braking = std::max(0.0, train.calculateBraking());
+    double time = 0.0;
+    double offset = _startOffset;
+    double speed = train.getCurrentSpeed();
+
+    for (size_t k = first; k < last && !_stalled; ++k) {
+        double length = train.getSegmentLength(k);
+        if (k == first) {
+            length = std::max(0.0, length - train.getPosition().distanceOnRail);
+        }
+        double limit = train.getSegmentRail(k)->getSpeedLimit();
+        speed = std::min(speed, limit);
+        planRail(length, limit, accel, braking, time, offset, speed);
+        _railExitTimes.push_back(time);
+    }
+
+    _endOffset = offset;
+    _duration = time;
+}
+
+void KinematicProfile::planRail(double length, double limit, double accel, double braking,
+                                double& time, double& offset, double& speed) {
+    // Same rule as the fixed step (TrainStateStore): accelerate below the
+    // cruise share of the limit, hold above it, and brake once the rail end
+    // is within both BRAKING_ZONE and the stopping distance k*v^2. Where
+    // the two meet below BRAKING_ZONE the stepped train alternates around
+    // remaining == k*v^2, which in the limit is a deceleration of
+    // braking / 3.6 that reaches zero speed at the rail end.
+    const double zone = TrainStateStore::BRAKING_ZONE;
+    const double cruise = limit * TrainStateStore::CRUISE_FRACTION;
+    const bool canBrake = braking > 0.0;
+    const double k = canBrake ? 1.8 / braking : 0.0;
+
+    double remaining = length;
+    enum { FREE, BRAKE, SLIDE } mode = FREE;
+    if (remaining < zone && (!canBrake || remaining < k * speed * speed)) {
+        mode = BRAKE;
+    }
+
+    // FREE -> BRAKE -> SLIDE, plus one switch to cruising inside FREE
+    for (int guard = 0; guard < 8 && remaining > DISTANCE_EPSILON; ++guard) {
+        double a = 0.0;
+        TrainState state = STATE_MAINTAINING;
+        if (mode == SLIDE) {
+            a = -braking / 3.6;
+            state = STATE_BRAKING;
+        } else if (mode == BRAKE) {
+            a = -braking;
+            state = STATE_BRAKING;
+        } else if (speed < cruise - SPEED_EPSILON) {
+            a = accel;
+            state = STATE_ACCELERATING;
+        }
+
+        if (speed <= SPEED_EPSILON && a <= 0.0) {
+            // No traction and no speed: the train never gets further
+            _stalled = true;
+            return;
+        }
+
+        // Earliest of: rail end, cruise speed reached, entering the zone,
+        // meeting remaining == k*v^2 while braking
+        double duration = firstRoot(0.5 * a, speed, -remaining);
+        int next = -1;   // Mode after this phase; -1 when the rail ends
+        if (mode == FREE) {
+            if (a > 0.0) {
+                double t = (cruise - speed) / a;
+                if (t > TIME_EPSILON && (duration < 0.0 || t < duration)) {
+                    duration = t;
+                    next = FREE;
+                }
+            }
+            // Zone entry: remaining < zone and remaining < k*v^2, both of
+            // which only become true as the train goes on
+            double tZone = (remaining < zone) ? 0.0
+                         : firstRoot(0.5 * a, speed, zone - remaining);
+            double tCurve = 0.0;
+            bool viaCurve = false;
+            if (canBrake && remaining >= k * speed * speed) {
+                tCurve = firstRoot(k * a * a + 0.5 * a, 2.0 * k * speed * a + speed,
+                                   k * speed * speed - remaining);
+                viaCurve = true;
+            }
+            if (tZone >= 0.0 && tCurve >= 0.0) {
+                double t = std::max(tZone, tCurve);
+                if (t > TIME_EPSILON && (duration < 0.0 || t < duration)) {
+                    duration = t;
+                    next = (viaCurve && tCurve >= tZone) ? SLIDE : BRAKE;
+                }
+            }
+        } else if (mode == BRAKE && canBrake) {
+            // remaining(t) == k*v(t)^2, reached before the train could stop
+            double t = firstRoot(k * a * a + 0.5 * a, 2.0 * k * speed * a + speed,
+                                 k * speed * speed - remaining);
+            if (t > 0.0 && (duration < 0.0 || t < duration)) {
+                duration = t;
+                next = SLIDE;
+            }
+        }
+
+        if (duration < 0.0) {
+            // Slide or brake ending at zero speed right at the rail end
+            duration = (a < 0.0) ? speed / -a : 0.0;
+            if (duration <= 0.0) {
+                _stalled = true;
+                return;
+            }
+        }
+
+        addPhase(time, offset, speed, a, state);
+        double travelled = speed * duration + 0.5 * a * duration * duration;
+        time += duration;
+        speed = std::max(0.0, speed + a * duration);
+        if (next < 0) {
+            offset += remaining;
+            return;
+        }
+        travelled = std::min(travelled, remaining);
+        offset += travelled;
+        remaining -= travelled;
+        mode = (next == FREE) ? FREE : (next == BRAKE ? BRAKE : SLIDE);
+    }
+    offset += remaining;
+}
+
+void KinematicProfile::sample(double hours, double& travelled, double& speed,
+                              TrainState& state) const {
+    if (hours >= _duration || _phases.empty()) {
+        travelled = _endOffset;
+        speed = 0.0;
+        state = _stalled ? STATE_WAITING : STATE_STOPPED;
+        return;
+    }
+
+    // Last phase starting at or before the requested time
+    size_t low = 0;
+    size_t high = _phases.size();
+    while (high - low > 1) {
+        size_t mid = (low + high) / 2;
+        if (_phases[mid].startTime <= hours) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    const Phase& phase = _phases[low];
+    double dt = std::max(0.0, hours - phase.startTime);
+    travelled = phase.startOffset + phase.startSpeed * dt + 0.5 * phase.accel * dt * dt;
+    speed = std::max(0.0, phase.startSpeed + phase.accel * dt);
+    state = phase.state;
+}
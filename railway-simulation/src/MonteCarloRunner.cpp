@@ -0,0 +1,149 @@
+#include "../incl/MonteCarloRunner.hpp"
+#include "../incl/EventFactory.hpp"
+#include "../incl/RandomStream.hpp"
+#include "../incl/ThreadPool.hpp"
+#include <algorithm>
+
+namespace {
+
+// Drawn disruption times
+const Tick DEFAULT_SPAN = 24 * TICKS_PER_HOUR;   // Horizon when a train never arrives
+const int MIN_RESTRICTION_MINUTES = 30;
+const int RESTRICTION_SPREAD_MINUTES = 90;
+
+/**
+ * Uniform tick in [from, to]
+ */
+Tick drawTick(RandomStream& random, Tick from, Tick to) {
+    if (to <= from) {
+        return from;
+    }
+    return from + static_cast<Tick>(random.nextDouble() * static_cast<double>(to - from));
+}
+
+/**
+ * One replication per index; each writes only its own arrivals row
+ */
+class ReplicationTask : public IParallelTask {
+private:
+    const MonteCarloRunner& _runner;
+    std::vector<std::vector<Tick> >& _arrivals;
+
+public:
+    ReplicationTask(const MonteCarloRunner& runner, std::vector<std::vector<Tick> >& arrivals)
+        : _runner(runner), _arrivals(arrivals) {}
+
+    virtual void execute(size_t index, size_t worker) {
+        (void)worker;
+        _runner.runReplication(static_cast<long long>(index), _arrivals[index]);
+    }
+};
+
+} // namespace
+
+Tick DelayDistribution::mean() const {
+    if (delays.empty()) {
+        return 0;
+    }
+    Tick total = 0;
+    for (size_t i = 0; i < delays.size(); ++i) {
+        total += delays[i];
+    }
+    return total / static_cast<Tick>(delays.size());
+}
+
+Tick DelayDistribution::percentile(double p) const {
+    if (delays.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p / 100.0 * delays.size() + 0.999999);
+    rank = std::max<size_t>(1, std::min(rank, delays.size()));
+    return delays[rank - 1];
+}
+
+MonteCarloRunner::MonteCarloRunner(const RailwayNetwork& network,
+                                   const std::vector<Train*>& trains)
+    : _network(network), _trains(trains), _replications(100), _seed(1),
+      _workerThreads(0), _steppingMode(STEPPING_FIXED) {
+}
+
+void MonteCarloRunner::run() {
+    _baseline.clear();
+    std::vector<Tick> baseline;
+    runReplication(-1, baseline);
+    _baseline = baseline;
+    
+    std::vector<std::vector<Tick> > arrivals(_replications);
+    ReplicationTask task(*this, arrivals);
+    ThreadPool pool(_workerThreads);
+    pool.run(task, _replications);
+    
+    _results.assign(_trains.size(), DelayDistribution());
+    for (size_t t = 0; t < _trains.size(); ++t) {
+        DelayDistribution& result = _results[t];
+        result.trainName = _trains[t]->getName();
+        
+        for (size_t r = 0; r < _replications; ++r) {
+            if (baseline[t] < 0 || arrivals[r][t] < 0) {
+                result.notArrived++;
+            } else {
+                result.delays.push_back(arrivals[r][t] - baseline[t]);
+            }
+        }
+        std::sort(result.delays.begin(), result.delays.end());
+    }
+}
+
+void MonteCarloRunner::runReplication(long long replication, std::vector<Tick>& arrivals) const {
+    SimulationManager simulation;
+    simulation.loadScenario(_network, _trains);
+    simulation.setSteppingMode(_steppingMode);
+    
+    // Disruptions, drawn in scenario order from this replication's stream
+    if (replication >= 0) {
+        RandomStream random(_seed, static_cast<unsigned long long>(replication));
+        RailwayNetwork* network = simulation.getNetwork();
+        const std::vector<Train*>& trains = simulation.getTrains();
+        const std::vector<Rail*>& rails = network->getRails();
+        
+        // Span of the undisturbed run
+        Tick first = 0;
+        Tick last = 0;
+        std::vector<Tick> until(trains.size());
+        for (size_t i = 0; i < trains.size(); ++i) {
+            Tick departure = trains[i]->getDepartureTime();
+            until[i] = (i < _baseline.size() && _baseline[i] >= departure)
+                     ? _baseline[i] : departure + DEFAULT_SPAN;
+            first = (i == 0) ? departure : std::min(first, departure);
+            last = (i == 0) ? until[i] : std::max(last, until[i]);
+        }
+        
+        for (size_t i = 0; i < trains.size(); ++i) {
+            IEvent* event = EventFactory::createRandomEvent(trains[i], random);
+            if (event != NULL) {
+                Tick start = drawTick(random, trains[i]->getDepartureTime(), until[i]);
+                simulation.scheduleEvent(event, start, start - 1); // One-shot, no end
+            }
+        }
+        for (size_t i = 0; i < rails.size(); ++i) {
+            IEvent* event = EventFactory::createRandomEvent(rails[i], random, network);
+            if (event != NULL) {
+                Tick start = drawTick(random, first, last);
+                Tick length = (MIN_RESTRICTION_MINUTES +
+                               random.nextInt(RESTRICTION_SPREAD_MINUTES + 1)) * TICKS_PER_MINUTE;
+                simulation.scheduleEvent(event, start, start + length);
+            }
+        }
+    }
+    
+    simulation.initialize();
+    simulation.run();
+    
+    const std::vector<Train*>& trains = simulation.getTrains();
+    arrivals.assign(trains.size(), -1);
+    for (size_t i = 0; i < trains.size(); ++i) {
+        if (trains[i]->hasArrived()) {
+            arrivals[i] = trains[i]->getCurrentTime();
+        }
+    }
+}
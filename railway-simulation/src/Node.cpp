@@ -1,8 +1,8 @@
 #include "../incl/Node.hpp"
 #include "../incl/Rail.hpp"
 
-Node::Node(const std::string& name) 
-    : _name(name), _isCity(false) {
+Node::Node(const std::string& name, int id) 
+    : _name(name), _id(id), _isCity(false) {
     determineIfCity();
 }
 
@@ -3,10 +3,20 @@
 #include <iomanip>
 #include <sstream>
 #include <cmath>
-OutputWriter::OutputWriter(Train* train) : _train(train) {
+
+namespace {
+
+const size_t WRITE_BUFFER_SIZE = 1 << 16;   // Bytes per streamed file write
+const size_t DURATION_WIDTH = 20;           // Longest formatDuration() fits
+
+} // namespace
+
+OutputWriter::OutputWriter(Train* train)
+    : _train(train), _network(NULL), _estimatedTime(0), _window(0),
+      _fileStarted(false), _durationOffset(0) {
     if (train != NULL) {
         std::ostringstream oss;
-        oss << train->getName() << "_" << train->getDepartureTime().toString() << ".result";
+        oss << train->getName() << "_" << formatClock(train->getDepartureTime()) << ".result";
         _filename = oss.str();
     }
 }
@@ -14,12 +24,19 @@ OutputWriter::OutputWriter(Train* train) : _train(train) {
 OutputWriter::~OutputWriter() {
 }
 
-void OutputWriter::addSnapshot(const SimulationSnapshot& snapshot) {
-    _snapshots.push_back(snapshot);
+size_t OutputWriter::getTraceMemory() const {
+    return _records.capacity() * sizeof(TraceRecord) + _positions.capacity() * sizeof(float);
 }
 
-void OutputWriter::setEstimatedTime(const Time& time) {
-    _estimatedTime = time;
+void OutputWriter::setStreaming(size_t window) {
+    _window = window;
+    if (_window > 0) {
+        _records.reserve(_window);
+    }
+}
+
+void OutputWriter::setEstimatedTime(Tick duration) {
+    _estimatedTime = duration;
 }
 
 void OutputWriter::onNotify(const std::string& event) {
@@ -28,6 +45,96 @@ void OutputWriter::onNotify(const std::string& event) {
     // Could log events
 }
 
+void OutputWriter::onStep(const StepView& view) {
+    if (_train == NULL) {
+        return;
+    }
+    
+    // Only record after departure time
+    const Position& pos = _train->getPosition();
+    if (_train->getCurrentTime() < _train->getDepartureTime() || pos.currentRail == NULL) {
+        return;
+    }
+    _network = view.getNetwork();
+    
+    TraceRecord record;
+    record.time = static_cast<int>(_train->getCurrentTime() / TICKS_PER_SECOND);
+    record.rail = pos.currentRail->getId();
+    record.startNode = pos.lastNode ? pos.lastNode->getId() : -1;
+    record.distanceRemaining = static_cast<float>(_train->getTotalDistanceToGo());
+    record.state = static_cast<unsigned char>(_train->getState());
+    record.positionsBegin = static_cast<unsigned int>(_positions.size());
+    
+    // Other departed trains on the same rail, running the same way
+    const std::vector<Train*>& occupants = view.getOccupants(pos.currentRail);
+    for (size_t j = 0; j < occupants.size() && record.positionCount < 0xFFFF; ++j) {
+        const Train* other = occupants[j];
+        if (other == _train || other->getCurrentTime() < other->getDepartureTime()) {
+            continue;
+        }
+        
+        const Position& otherPos = other->getPosition();
+        if (otherPos.currentRail == pos.currentRail &&
+            otherPos.lastNode == pos.lastNode &&
+            otherPos.nextNode == pos.nextNode) {
+            _positions.push_back(static_cast<float>(otherPos.distanceOnRail));
+            record.positionCount++;
+        }
+    }
+    
+    _records.push_back(record);
+    if (_window > 0 && _records.size() >= _window) {
+        appendRecords();
+    }
+}
+
+bool OutputWriter::appendRecords() {
+    // One large buffer for the whole run, so a window goes out in few writes
+    if (!_fileStarted) {
+        _buffer.resize(WRITE_BUFFER_SIZE);
+        _stream.rdbuf()->pubsetbuf(&_buffer[0], _buffer.size());
+        _stream.open(_filename.c_str(), std::ios::trunc);
+        if (!_stream.is_open()) {
+            std::cerr << "ERROR: Cannot create output file: " << _filename << std::endl;
+            return false;
+        }
+        _stream << "Train: " << _train->getName() << "\n";
+        _stream << "Final travel time: ";
+        _durationOffset = _stream.tellp();
+        _stream << std::string(DURATION_WIDTH, ' ') << "\n\n";
+        _fileStarted = true;
+    }
+    if (!_stream.is_open()) {
+        return false;
+    }
+    writeRecords(_stream);
+    
+    // Keep the capacity, the next window fills it again
+    _records.clear();
+    _positions.clear();
+    return true;
+}
+
+void OutputWriter::writeRecords(std::ostream& out) const {
+    // Names are resolved only now (records imply a network)
+    for (size_t i = 0; i < _records.size(); ++i) {
+        const TraceRecord& record = _records[i];
+        const Rail* rail = _network->getRails()[record.rail];
+        Node* start = record.startNode >= 0 ? _network->getNodeById(record.startNode) : NULL;
+        Node* end = start ? rail->getOtherNode(start) : NULL;
+        
+        out << "[" << formatClock(record.time * TICKS_PER_SECOND) << "] - "
+            << "[" << formatNode(start ? start->getName() : "") << "]"
+            << "[" << formatNode(end ? end->getName() : "") << "] - "
+            << "[" << std::fixed << std::setprecision(2) 
+            << record.distanceRemaining << "km] - "
+            << "[" << std::setw(8)
+            << Train::getStateName(static_cast<TrainState>(record.state)) << "] - "
+            << generateVisualGraph(record, rail->getLength())
+            << "\n";
+    }
+}
+
 std::string OutputWriter::formatNode(const std::string& nodeName) const {
     // Format to fixed width for alignment
     std::ostringstream oss;
@@ -35,17 +142,17 @@ std::string OutputWriter::formatNode(const std::string& nodeName) const {
     return oss.str();
 }
 
-std::string OutputWriter::generateVisualGraph(const SimulationSnapshot& snapshot) const {
+std::string OutputWriter::generateVisualGraph(const TraceRecord& record, double railLength) const {
     std::ostringstream oss;
     
     // One cell per kilometer of THIS segment
-    int totalCells = std::max(1, static_cast<int>(std::ceil(snapshot.railLength)));
+    int totalCells = std::max(1, static_cast<int>(std::ceil(railLength)));
     if (totalCells > 50) totalCells = 50; // Limit visual size
     
     // Calculate train position on THIS segment (distance traveled from start)
-    double distanceOnSegment = snapshot.railLength - snapshot.distanceRemaining;
+    double distanceOnSegment = railLength - record.distanceRemaining;
     if (distanceOnSegment < 0.0) distanceOnSegment = 0.0;
-    if (distanceOnSegment > snapshot.railLength) distanceOnSegment = snapshot.railLength;
+    if (distanceOnSegment > railLength) distanceOnSegment = railLength;
     
     int trainCell = static_cast<int>(std::floor(distanceOnSegment));
     if (trainCell >= totalCells) trainCell = totalCells - 1;
@@ -53,26 +160,26 @@ std::string OutputWriter::generateVisualGraph(const SimulationSnapshot& snapshot
     
     // Mark other trains (robustly accept km, percent (0-100), or fraction (0-1))
     std::vector<bool> otherAt(totalCells, false);
-    for (size_t j = 0; j < snapshot.otherTrainPositions.size(); ++j) {
-        double p = snapshot.otherTrainPositions[j];
+    for (size_t j = 0; j < record.positionCount; ++j) {
+        double p = _positions[record.positionsBegin + j];
         double posKm = 0.0;
         if (p < 0.0) continue;
         const double eps = 1e-6;
-        if (p <= snapshot.railLength + eps) {
+        if (p <= railLength + eps) {
             // provided in kilometers
             posKm = p;
         } else if (p <= 1.0 + eps) {
             // fraction of segment (0..1)
-            posKm = p * snapshot.railLength;
+            posKm = p * railLength;
         } else if (p <= 100.0 + eps) {
             // percent (0..100)
-            posKm = (p / 100.0) * snapshot.railLength;
+            posKm = (p / 100.0) * railLength;
         } else {
             // fallback treat as kilometers
             posKm = p;
         }
         if (posKm < 0.0) continue;
-        if (posKm > snapshot.railLength) posKm = snapshot.railLength;
+        if (posKm > railLength) posKm = railLength;
         int otherCell = static_cast<int>(std::floor(posKm));
         if (otherCell >= totalCells) otherCell = totalCells - 1;
         if (otherCell >= 0 && otherCell < totalCells) otherAt[otherCell] = true;
@@ -99,6 +206,22 @@ void OutputWriter::writeToFile() {
         return;
     }
     
+    if (_window > 0 || _fileStarted) {
+        // Last rows, then the travel time into the reserved header field
+        if (!appendRecords()) {
+            return;
+        }
+        _stream.seekp(_durationOffset);
+        _stream << formatDuration(_estimatedTime);
+        _stream.close();
+        if (_stream.fail()) {
+            std::cerr << "ERROR: Cannot update output file: " << _filename << std::endl;
+            return;
+        }
+        std::cout << "Output written to: " << _filename << std::endl;
+        return;
+    }
+    
     std::ofstream outFile(_filename.c_str());
     if (!outFile.is_open()) {
         std::cerr << "ERROR: Cannot create output file: " << _filename << std::endl;
@@ -107,23 +230,10 @@ void OutputWriter::writeToFile() {
     
     // Write header
     outFile << "Train: " << _train->getName() << std::endl;
-    outFile << "Final travel time: " << _estimatedTime.toString() << std::endl;
+    outFile << "Final travel time: " << formatDuration(_estimatedTime) << std::endl;
     outFile << std::endl;
     
-    // Write snapshots
-    for (size_t i = 0; i < _snapshots.size(); ++i) {
-        const SimulationSnapshot& snap = _snapshots[i];
-        
-        outFile << "[" << snap.time.toString() << "] - "
-                << "[" << formatNode(snap.startNode) << "]"
-                << "[" << formatNode(snap.endNode) << "] - "
-                << "[" << std::fixed << std::setprecision(2) 
-                << snap.distanceRemaining << "km] - "
-                << "[" << std::setw(8) << snap.action << "] - "
-                << generateVisualGraph(snap)
-                << std::endl;
-    }
-    
+    writeRecords(outFile);
     outFile.close();
     
     std::cout << "Output written to: " << _filename << std::endl;
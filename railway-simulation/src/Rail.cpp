@@ -2,8 +2,38 @@
 #include "../incl/Train.hpp"
 #include <algorithm>
 
-Rail::Rail(Node* start, Node* end, double length, double speedLimit)
-    : _startNode(start), _endNode(end), _length(length), _speedLimit(speedLimit) {
+namespace {
+
+// Node the train entered the rail from: trains sharing it travel the same way
+int directionOf(const Train* train) {
+    const Node* from = train->getPosition().lastNode;
+    return (from != NULL) ? from->getId() : -1;
+}
+
+// Rear-to-front order of trains on one rail, one direction after the other
+bool isBehind(const Train* a, const Train* b) {
+    int directionA = directionOf(a);
+    int directionB = directionOf(b);
+    if (directionA != directionB) {
+        return directionA < directionB;
+    }
+    double distanceA = a->getPosition().distanceOnRail;
+    double distanceB = b->getPosition().distanceOnRail;
+    if (distanceA != distanceB) {
+        return distanceA < distanceB;
+    }
+    // Queued at the same spot: the earlier departure is ahead
+    if (a->getDepartureTime() != b->getDepartureTime()) {
+        return a->getDepartureTime() > b->getDepartureTime();
+    }
+    return a->getId() > b->getId();
+}
+
+} // namespace
+
+Rail::Rail(Node* start, Node* end, double length, double speedLimit, int id)
+    : _id(id), _startNode(start), _endNode(end), _length(length), _speedLimit(speedLimit),
+      _nominalSpeedLimit(speedLimit) {
     
     if (start != NULL) {
         start->addRail(this);
@@ -26,18 +56,61 @@ Node* Rail::getOtherNode(Node* node) const {
     return NULL;
 }
 
+void Rail::setSpeedLimit(double speedLimit) {
+    _nominalSpeedLimit = speedLimit;
+    refreshSpeedLimit();
+}
+
+void Rail::addSpeedRestriction(double factor) {
+    _speedFactors.push_back(factor);
+    refreshSpeedLimit();
+}
+
+void Rail::removeSpeedRestriction(double factor) {
+    std::vector<double>::iterator it = std::find(_speedFactors.begin(),
+                                                 _speedFactors.end(), factor);
+    if (it != _speedFactors.end()) {
+        _speedFactors.erase(it);
+    }
+    refreshSpeedLimit();
+}
+
+void Rail::restoreSpeedLimit(double nominalSpeedLimit, const std::vector<double>& factors) {
+    _nominalSpeedLimit = nominalSpeedLimit;
+    _speedFactors = factors;
+    refreshSpeedLimit();
+}
+
+void Rail::refreshSpeedLimit() {
+    double factor = 1.0;
+    for (size_t i = 0; i < _speedFactors.size(); ++i) {
+        factor = std::min(factor, _speedFactors[i]);
+    }
+    _speedLimit = _nominalSpeedLimit * factor;
+}
+
 void Rail::addTrain(Train* train) {
     if (train != NULL) {
-        _occupyingTrains.push_back(train);
+        _occupyingTrains.insert(std::upper_bound(_occupyingTrains.begin(),
+                                                 _occupyingTrains.end(),
+                                                 train, isBehind),
+                                train);
     }
 }
 
 void Rail::removeTrain(Train* train) {
-    std::vector<Train*>::iterator it = std::find(_occupyingTrains.begin(), 
-                                                   _occupyingTrains.end(), 
-                                                   train);
-    if (it != _occupyingTrains.end()) {
-        _occupyingTrains.erase(it);
+    // Trains leave at the far end, which is the back of the vector
+    std::vector<Train*>::reverse_iterator it = std::find(_occupyingTrains.rbegin(),
+                                                         _occupyingTrains.rend(),
+                                                         train);
+    if (it != _occupyingTrains.rend()) {
+        _occupyingTrains.erase(--it.base());
+    }
+}
+
+void Rail::appendTrain(Train* train) {
+    if (train != NULL) {
+        _occupyingTrains.push_back(train);
     }
 }
 
@@ -45,23 +118,33 @@ bool Rail::isOccupied() const {
     return !_occupyingTrains.empty();
 }
 
-Train* Rail::getTrainAhead(Train* train, double position) const {
-    // Find closest train ahead on this rail
-    Train* closestTrain = NULL;
-    double minDistance = _length;
-    
-    for (size_t i = 0; i < _occupyingTrains.size(); ++i) {
-        if (_occupyingTrains[i] != train) {
-            const Position& otherPos = _occupyingTrains[i]->getPosition();
-            if (otherPos.currentRail == this) {
-                double distance = otherPos.distanceOnRail - position;
-                if (distance > 0 && distance < minDistance) {
-                    minDistance = distance;
-                    closestTrain = _occupyingTrains[i];
-                }
-            }
+void Rail::sortOccupants() {
+    for (size_t i = 1; i < _occupyingTrains.size(); ++i) {
+        Train* train = _occupyingTrains[i];
+        size_t j = i;
+        while (j > 0 && isBehind(train, _occupyingTrains[j - 1])) {
+            _occupyingTrains[j] = _occupyingTrains[j - 1];
+            --j;
         }
+        _occupyingTrains[j] = train;
     }
-    
-    return closestTrain;
+}
+
+Train* Rail::getTrainAhead(Train* train) const {
+    std::vector<Train*>::const_iterator it = std::lower_bound(_occupyingTrains.begin(),
+                                                              _occupyingTrains.end(),
+                                                              train, isBehind);
+    if (it == _occupyingTrains.end() || *it != train) {
+        // Moved since the last sortOccupants()
+        it = std::find(_occupyingTrains.begin(), _occupyingTrains.end(), train);
+        if (it == _occupyingTrains.end()) {
+            return NULL;
+        }
+    }
+    ++it;
+    if (it == _occupyingTrains.end() ||
+        (*it)->getPosition().lastNode != train->getPosition().lastNode) {
+        return NULL; // Front of its direction
+    }
+    return *it;
 }
@@ -1,6 +1,6 @@
 #include "../incl/RailwayNetwork.hpp"
 
-RailwayNetwork::RailwayNetwork() {
+RailwayNetwork::RailwayNetwork() : _graphDirty(true) {
 }
 
 RailwayNetwork::~RailwayNetwork() {
@@ -12,8 +12,10 @@ Node* RailwayNetwork::addNode(const std::string& name) {
         return _nodes[name]; // Already exists
     }
     
-    Node* node = new Node(name);
+    Node* node = new Node(name, static_cast<int>(_nodesById.size()));
+    _graphDirty = true;
     _nodes[name] = node;
+    _nodesById.push_back(node);
     return node;
 }
 
@@ -25,6 +27,13 @@ Node* RailwayNetwork::getNode(const std::string& name) const {
     return NULL;
 }
 
+Node* RailwayNetwork::getNodeById(int id) const {
+    if (id < 0 || static_cast<size_t>(id) >= _nodesById.size()) {
+        return NULL;
+    }
+    return _nodesById[id];
+}
+
 bool RailwayNetwork::hasNode(const std::string& name) const {
     return _nodes.find(name) != _nodes.end();
 }
@@ -39,11 +48,102 @@ Rail* RailwayNetwork::addRail(const std::string& startName,
         return NULL;
     }
     
-    Rail* rail = new Rail(start, end, length, speedLimit);
+    Rail* rail = new Rail(start, end, length, speedLimit,
+                          static_cast<int>(_rails.size()));
     _rails.push_back(rail);
+    _graphDirty = true;
+    
+    for (size_t i = 0; i < _listeners.size(); ++i) {
+        _listeners[i]->onRailAdded(rail);
+    }
     return rail;
 }
 
+void RailwayNetwork::setRailSpeedLimit(Rail* rail, double speedLimit) {
+    if (rail == NULL || rail->getNominalSpeedLimit() == speedLimit) {
+        return;
+    }
+    
+    double oldSpeedLimit = rail->getSpeedLimit();
+    rail->setSpeedLimit(speedLimit);
+    speedLimitChanged(rail, oldSpeedLimit);
+}
+
+void RailwayNetwork::addSpeedRestriction(Rail* rail, double factor) {
+    if (rail == NULL) {
+        return;
+    }
+    double oldSpeedLimit = rail->getSpeedLimit();
+    rail->addSpeedRestriction(factor);
+    speedLimitChanged(rail, oldSpeedLimit);
+}
+
+void RailwayNetwork::removeSpeedRestriction(Rail* rail, double factor) {
+    if (rail == NULL) {
+        return;
+    }
+    double oldSpeedLimit = rail->getSpeedLimit();
+    rail->removeSpeedRestriction(factor);
+    speedLimitChanged(rail, oldSpeedLimit);
+}
+
+void RailwayNetwork::restoreSpeedLimit(Rail* rail, double nominalSpeedLimit,
+                                       const std::vector<double>& factors) {
+    if (rail == NULL) {
+        return;
+    }
+    double oldSpeedLimit = rail->getSpeedLimit();
+    rail->restoreSpeedLimit(nominalSpeedLimit, factors);
+    speedLimitChanged(rail, oldSpeedLimit);
+}
+
+void RailwayNetwork::speedLimitChanged(Rail* rail, double oldSpeedLimit) {
+    if (rail->getSpeedLimit() == oldSpeedLimit) {
+        return;
+    }
+    _graphDirty = true;
+    
+    for (size_t i = 0; i < _listeners.size(); ++i) {
+        _listeners[i]->onSpeedLimitChanged(rail, oldSpeedLimit);
+    }
+}
+
+const CsrGraph& RailwayNetwork::getGraph() const {
+    if (_graphDirty) {
+        _graph.build(*this);
+        _graphDirty = false;
+    }
+    return _graph;
+}
+
+void RailwayNetwork::addListener(INetworkListener* listener) {
+    if (listener != NULL) {
+        _listeners.push_back(listener);
+    }
+}
+
+void RailwayNetwork::removeListener(INetworkListener* listener) {
+    for (size_t i = 0; i < _listeners.size(); ++i) {
+        if (_listeners[i] == listener) {
+            _listeners.erase(_listeners.begin() + i);
+            break;
+        }
+    }
+}
+
+RailwayNetwork* RailwayNetwork::clone() const {
+    RailwayNetwork* copy = new RailwayNetwork();
+    for (size_t i = 0; i < _nodesById.size(); ++i) {
+        copy->addNode(_nodesById[i]->getName());
+    }
+    for (size_t i = 0; i < _rails.size(); ++i) {
+        copy->addRail(_rails[i]->getStartNode()->getName(),
+                      _rails[i]->getEndNode()->getName(),
+                      _rails[i]->getLength(), _rails[i]->getNominalSpeedLimit());
+    }
+    return copy;
+}
+
 void RailwayNetwork::clear() {
     // Delete all rails
     for (size_t i = 0; i < _rails.size(); ++i) {
@@ -57,4 +157,6 @@ void RailwayNetwork::clear() {
         delete it->second;
     }
     _nodes.clear();
+    _nodesById.clear();
+    _graphDirty = true;
 }
@@ -0,0 +1,35 @@
+#include "../incl/RandomStream.hpp"
+
+namespace {
+
+const unsigned long long GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+} // namespace
+
+RandomStream::RandomStream(unsigned long long seed, unsigned long long stream)
+    : _key(mix(seed ^ mix(stream + GOLDEN_GAMMA))), _counter(0) {
+}
+
+unsigned long long RandomStream::next() {
+    ++_counter;
+    return mix(_key + _counter * GOLDEN_GAMMA);
+}
+
+int RandomStream::nextInt(int bound) {
+    if (bound <= 0) {
+        return 0;
+    }
+    return static_cast<int>(next() % static_cast<unsigned long long>(bound));
+}
+
+double RandomStream::nextDouble() {
+    // Top 53 bits fill the mantissa
+    return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+unsigned long long RandomStream::mix(unsigned long long value) {
+    // SplitMix64 finalizer
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
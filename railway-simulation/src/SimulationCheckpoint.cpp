@@ -0,0 +1,291 @@
+#include "../incl/SimulationManager.hpp"
+#include "../incl/BinaryIO.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char CHECKPOINT_MAGIC[4] = { 'R', 'S', 'C', 'K' };
+const unsigned int CHECKPOINT_VERSION = 3;
+const unsigned long long MAX_ENTRIES = 1ull << 32;   // Per saved vector
+
+void hashBytes(unsigned int& hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+}
+
+// FNV-1a over the rails and trains, so a checkpoint is only restored into
+// the scenario it came from (speed limits are part of the saved state)
+unsigned int scenarioFingerprint(const RailwayNetwork& network,
+                                 const std::vector<Train*>& trains) {
+    unsigned int hash = 2166136261u;
+
+    const std::vector<Rail*>& rails = network.getRails();
+    for (size_t i = 0; i < rails.size(); ++i) {
+        int ids[2] = { rails[i]->getStartNode()->getId(),
+                       rails[i]->getEndNode()->getId() };
+        double length = rails[i]->getLength();
+        hashBytes(hash, ids, sizeof(ids));
+        hashBytes(hash, &length, sizeof(length));
+    }
+    for (size_t i = 0; i < trains.size(); ++i) {
+        const std::string& name = trains[i]->getName();
+        int ids[2] = { trains[i]->getDeparture() ? trains[i]->getDeparture()->getId() : -1,
+                       trains[i]->getDestination() ? trains[i]->getDestination()->getId() : -1 };
+        hashBytes(hash, name.data(), name.size());
+        hashBytes(hash, ids, sizeof(ids));
+    }
+    return hash;
+}
+
+/**
+ * Runtime state of one train as saved
+ */
+struct SavedTrain {
+    int state;
+    double speed;
+    double distance;
+    Tick time;
+    Tick departureTime;
+    Tick holdUntil;
+    unsigned long long pathIndex;
+    std::vector<int> path;           // Node ids
+};
+
+/**
+ * Speed limits and occupancy of one rail as saved
+ */
+struct SavedRail {
+    double nominalSpeedLimit;
+    std::vector<double> factors;
+    std::vector<unsigned int> occupants;   // Train indices, in rail order
+    std::vector<unsigned int> diverted;    // Trains re-routed off this rail
+};
+
+} // namespace
+
+bool SimulationManager::saveCheckpoint(const std::string& filename) const {
+    if (_network == NULL) {
+        return false;
+    }
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "ERROR: Cannot create checkpoint file: " << filename << std::endl;
+        return false;
+    }
+
+    const std::vector<Rail*>& rails = _network->getRails();
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeBinary(out, CHECKPOINT_VERSION);
+    writeBinary(out, scenarioFingerprint(*_network, _trains));
+    writeBinary(out, static_cast<unsigned long long>(_trains.size()));
+    writeBinary(out, static_cast<unsigned long long>(rails.size()));
+    writeBinary(out, _currentTime);
+    writeBinary(out, _step);
+    writeBinary(out, static_cast<unsigned long long>(_stepCount));
+    writeBinary(out, static_cast<unsigned long long>(_rerouteCount));
+
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        const Train* train = _trains[i];
+        std::vector<int> path(train->getPath().size());
+        for (size_t k = 0; k < path.size(); ++k) {
+            path[k] = train->getPath()[k]->getId();
+        }
+
+        writeBinary(out, static_cast<int>(train->getState()));
+        writeBinary(out, train->getCurrentSpeed());
+        writeBinary(out, train->getPosition().distanceOnRail);
+        writeBinary(out, train->getCurrentTime());
+        writeBinary(out, train->getDepartureTime());
+        writeBinary(out, train->getHoldUntil());
+        writeBinary(out, static_cast<unsigned long long>(train->getCurrentPathIndex()));
+        writeBinaryVector(out, path);
+    }
+
+    for (size_t r = 0; r < rails.size(); ++r) {
+        // Only this simulation's trains, in their current rail order
+        const std::vector<Train*>& occupying = rails[r]->getOccupyingTrains();
+        std::vector<unsigned int> occupants;
+        for (size_t k = 0; k < occupying.size(); ++k) {
+            size_t index = static_cast<size_t>(occupying[k]->getId() - 1);
+            if (index < _trains.size() && _trains[index] == occupying[k]) {
+                occupants.push_back(static_cast<unsigned int>(index));
+            }
+        }
+        std::vector<unsigned int> diverted;
+        if (r < _divertedByRail.size()) {
+            diverted.assign(_divertedByRail[r].begin(), _divertedByRail[r].end());
+        }
+
+        writeBinary(out, rails[r]->getNominalSpeedLimit());
+        writeBinaryVector(out, rails[r]->getSpeedRestrictions());
+        writeBinaryVector(out, occupants);
+        writeBinaryVector(out, diverted);
+    }
+
+    // Analytic profiles, empty outside STEPPING_ANALYTIC
+    writeBinaryVector(out, _profileHours);
+    for (size_t i = 0; i < _profileHours.size(); ++i) {
+        _profiles[i].save(out);
+    }
+
+    if (!_events.save(out)) {
+        std::cerr << "ERROR: A pending event cannot be saved in a checkpoint" << std::endl;
+        return false;
+    }
+    return out.good();
+}
+
+bool SimulationManager::restoreCheckpoint(const std::string& filename) {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (_network == NULL || !in.is_open()) {
+        return false;
+    }
+
+    // Read and check everything before touching the simulation
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    unsigned int version = 0;
+    unsigned int fingerprint = 0;
+    unsigned long long trainCount = 0;
+    unsigned long long railCount = 0;
+    Tick currentTime = 0;
+    Tick step = 0;
+    unsigned long long stepCount = 0;
+    unsigned long long rerouteCount = 0;
+
+    size_t rails = _network->getRails().size();
+    size_t nodes = _network->getNodeCount();
+    in.read(magic, sizeof(magic));
+    if (!in.good() || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+        !readBinary(in, version) || version != CHECKPOINT_VERSION ||
+        !readBinary(in, fingerprint) || fingerprint != scenarioFingerprint(*_network, _trains) ||
+        !readBinary(in, trainCount) || trainCount != _trains.size() ||
+        !readBinary(in, railCount) || railCount != rails ||
+        !readBinary(in, currentTime) || !readBinary(in, step) ||
+        !readBinary(in, stepCount) || !readBinary(in, rerouteCount)) {
+        return false;
+    }
+
+    std::vector<SavedTrain> savedTrains(_trains.size());
+    for (size_t i = 0; i < savedTrains.size(); ++i) {
+        SavedTrain& saved = savedTrains[i];
+        if (!readBinary(in, saved.state) || !isTrainState(saved.state) ||
+            !readBinary(in, saved.speed) ||
+            !readBinary(in, saved.distance) || !readBinary(in, saved.time) ||
+            !readBinary(in, saved.departureTime) || !readBinary(in, saved.holdUntil) ||
+            !readBinary(in, saved.pathIndex) ||
+            !readBinaryVector(in, saved.path, nodes) ||
+            saved.pathIndex > saved.path.size()) {
+            return false;
+        }
+        for (size_t k = 0; k < saved.path.size(); ++k) {
+            if (saved.path[k] < 0 || static_cast<size_t>(saved.path[k]) >= nodes) {
+                return false;
+            }
+        }
+    }
+
+    std::vector<SavedRail> savedRails(rails);
+    for (size_t r = 0; r < rails; ++r) {
+        SavedRail& saved = savedRails[r];
+        if (!readBinary(in, saved.nominalSpeedLimit) ||
+            !readBinaryVector(in, saved.factors, MAX_ENTRIES) ||
+            !readBinaryVector(in, saved.occupants, trainCount) ||
+            !readBinaryVector(in, saved.diverted, MAX_ENTRIES)) {
+            return false;
+        }
+        for (size_t k = 0; k < saved.occupants.size(); ++k) {
+            if (saved.occupants[k] >= trainCount) {
+                return false;
+            }
+        }
+        for (size_t k = 0; k < saved.diverted.size(); ++k) {
+            if (saved.diverted[k] >= trainCount) {
+                return false;
+            }
+        }
+    }
+
+    std::vector<double> profileHours;
+    if (!readBinaryVector(in, profileHours, trainCount) ||
+        (!profileHours.empty() && profileHours.size() != trainCount)) {
+        return false;
+    }
+    std::vector<KinematicProfile> profiles(_trains.size());
+    for (size_t i = 0; i < profileHours.size(); ++i) {
+        if (!profiles[i].restore(in)) {
+            return false;
+        }
+    }
+
+    EventScheduler events;
+    if (!events.restore(in, _network, _trains)) {
+        return false;
+    }
+
+    // Rail limits first, while no re-routing can react to them
+    stopListening();
+    for (size_t r = 0; r < rails; ++r) {
+        _network->restoreSpeedLimit(_network->getRails()[r], savedRails[r].nominalSpeedLimit,
+                                    savedRails[r].factors);
+    }
+
+    // Take this simulation's trains off every rail, then put them back
+    // in the saved order
+    for (size_t r = 0; r < rails; ++r) {
+        Rail* rail = _network->getRails()[r];
+        std::vector<Train*> occupying = rail->getOccupyingTrains();
+        for (size_t k = 0; k < occupying.size(); ++k) {
+            size_t index = static_cast<size_t>(occupying[k]->getId() - 1);
+            if (index < _trains.size() && _trains[index] == occupying[k]) {
+                rail->removeTrain(occupying[k]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        const SavedTrain& saved = savedTrains[i];
+        std::vector<Node*> path(saved.path.size());
+        for (size_t k = 0; k < path.size(); ++k) {
+            path[k] = _network->getNodeById(saved.path[k]);
+        }
+
+        Train* train = _trains[i];
+        train->restoreProgress(path, static_cast<size_t>(saved.pathIndex), saved.distance);
+        train->setState(static_cast<TrainState>(saved.state));
+        train->setCurrentSpeed(saved.speed);
+        train->setCurrentTime(saved.time);
+        train->setDepartureTime(saved.departureTime);
+        train->setHoldUntil(saved.holdUntil);
+    }
+
+    for (size_t r = 0; r < rails; ++r) {
+        for (size_t k = 0; k < savedRails[r].occupants.size(); ++k) {
+            _network->getRails()[r]->appendTrain(_trains[savedRails[r].occupants[k]]);
+        }
+    }
+
+    // Same setup as initialize(), then the saved bookkeeping on top
+    _network->getGraph();
+    prepareRun();
+    if (!profileHours.empty()) {
+        _profiles.swap(profiles);
+        _profileHours.swap(profileHours);
+    }
+    if (!_divertedByRail.empty()) {
+        for (size_t r = 0; r < rails; ++r) {
+            _divertedByRail[r].assign(savedRails[r].diverted.begin(),
+                                      savedRails[r].diverted.end());
+        }
+    }
+    _rerouteCount = static_cast<size_t>(rerouteCount);
+    _stepCount = static_cast<size_t>(stepCount);
+    _events.swap(events);
+    _currentTime = currentTime;
+    _step = step;
+    return true;
+}
@@ -1,19 +1,148 @@
 #include "../incl/SimulationManager.hpp"
 #include "../incl/DijkstraPathfinding.hpp"
+#include "../incl/DiscreteEventEngine.hpp"
+#include "../incl/ThreadPool.hpp"
 #include <algorithm>
 #include <cmath>
+#include <map>
 
 SimulationManager* SimulationManager::_instance = NULL;
 
+namespace {
+
+/**
+ * Point-to-point routing: one findPath per train on the worker's own clone
+ */
+class RouteTask : public IParallelTask {
+private:
+    const std::vector<Train*>& _trains;
+    const std::vector<IPathfindingStrategy*>& _workers;
+    std::vector<std::vector<Node*> >& _routes;
+
+public:
+    RouteTask(const std::vector<Train*>& trains,
+              const std::vector<IPathfindingStrategy*>& workers,
+              std::vector<std::vector<Node*> >& routes)
+        : _trains(trains), _workers(workers), _routes(routes) {}
+
+    virtual void execute(size_t index, size_t worker) {
+        _routes[index] = _workers[worker]->findPath(_trains[index]->getDeparture(),
+                                                    _trains[index]->getDestination());
+    }
+};
+
+/**
+ * Shared-tree routing: one shortest-path tree per origin, with search
+ * scratch kept per worker
+ */
+class TreeTask : public IParallelTask {
+private:
+    struct Scratch {
+        DijkstraPathfinding dijkstra;
+        std::vector<double> distances;
+        std::vector<Node*> previous;
+
+        explicit Scratch(const RailwayNetwork* network) : dijkstra(network) {}
+    };
+
+    const std::vector<Train*>& _trains;
+    const std::vector<std::pair<Node*, std::vector<size_t> > >& _origins;
+    size_t _nodeCount;
+    std::vector<Scratch> _scratch;
+    std::vector<std::vector<Node*> >& _routes;
+
+public:
+    TreeTask(const std::vector<Train*>& trains,
+             const std::vector<std::pair<Node*, std::vector<size_t> > >& origins,
+             const RailwayNetwork* network, size_t workers,
+             std::vector<std::vector<Node*> >& routes)
+        : _trains(trains), _origins(origins), _nodeCount(network->getNodeCount()),
+          _scratch(workers, Scratch(network)), _routes(routes) {}
+
+    virtual void execute(size_t index, size_t worker) {
+        Scratch& scratch = _scratch[worker];
+        Node* origin = _origins[index].first;
+        scratch.dijkstra.computeTree(origin, _nodeCount,
+                                     scratch.distances, scratch.previous);
+
+        const std::vector<size_t>& members = _origins[index].second;
+        for (size_t m = 0; m < members.size(); ++m) {
+            Node* destination = _trains[members[m]]->getDestination();
+            std::vector<Node*>& route = _routes[members[m]];
+
+            if (destination == origin) {
+                route.push_back(origin);
+                continue;
+            }
+            if (scratch.previous[destination->getId()] == NULL) {
+                continue; // Unreachable
+            }
+
+            for (Node* node = destination; node != NULL;
+                 node = scratch.previous[node->getId()]) {
+                route.push_back(node);
+            }
+            std::reverse(route.begin(), route.end());
+        }
+    }
+};
+
+/**
+ * Re-routing: one search per distinct (origin, destination) on the
+ * worker's own Dijkstra
+ */
+class RerouteTask : public IParallelTask {
+private:
+    const std::vector<std::pair<Node*, Node*> >& _queries;
+    const std::vector<DijkstraPathfinding*>& _workers;
+    std::vector<std::vector<Node*> >& _routes;
+
+public:
+    RerouteTask(const std::vector<std::pair<Node*, Node*> >& queries,
+                const std::vector<DijkstraPathfinding*>& workers,
+                std::vector<std::vector<Node*> >& routes)
+        : _queries(queries), _workers(workers), _routes(routes) {}
+
+    virtual void execute(size_t index, size_t worker) {
+        _routes[index] = _workers[worker]->findPath(_queries[index].first,
+                                                    _queries[index].second);
+    }
+};
+
+/**
+ * Travel time of a route under the current weights (max() once it
+ * crosses a closed rail)
+ */
+double routeCost(const std::vector<Node*>& route, size_t from) {
+    double cost = 0.0;
+    for (size_t i = from; i + 1 < route.size(); ++i) {
+        cost += DijkstraPathfinding::calculateCost(route[i]->getRailTo(route[i + 1]));
+    }
+    return cost;
+}
+
+} // namespace
+
 SimulationManager::SimulationManager() 
-    : _network(NULL), _pathfinder(NULL), _timeStepMinutes(5) {
+    : _network(NULL), _pathfinder(NULL), _currentTime(0),
+      _timeStep(5 * TICKS_PER_MINUTE), _step(5 * TICKS_PER_MINUTE), _adaptiveStep(false),
+      _minStep(TICKS_PER_MINUTE), _maxStep(TICKS_PER_HOUR),
+      _routingMode(ROUTING_POINT_TO_POINT), _steppingMode(STEPPING_FIXED),
+      _workerThreads(1), _railPass(0), _arrivedCount(0), _scheduled(false), _stepCount(0),
+      _maxSteps(10000), _stepPool(NULL),
+      _ownsScenario(false), _rerouting(false), _listening(false), _rerouteCount(0),
+      _engine(NULL) {
 }
 
 SimulationManager::~SimulationManager() {
-    // Don't delete network and trains - they're managed externally
+    // Network and trains are managed externally unless loadScenario() copied them
+    stopListening();
+    releaseScenario();
+    releaseRerouters();
     if (_pathfinder != NULL) {
         delete _pathfinder;
     }
+    delete _stepPool;
 }
 
 SimulationManager* SimulationManager::getInstance() {
@@ -31,13 +160,58 @@ void SimulationManager::destroyInstance() {
 }
 
 void SimulationManager::setNetwork(RailwayNetwork* network) {
+    stopListening();
+    releaseRerouters();
     _network = network;
 }
 
 void SimulationManager::addTrain(Train* train) {
     if (train != NULL) {
         _trains.push_back(train);
+        train->setId(static_cast<int>(_trains.size()));
+        _scheduled = false;
+    }
+}
+
+void SimulationManager::loadScenario(const RailwayNetwork& network,
+                                     const std::vector<Train*>& trains) {
+    releaseScenario();
+    setPathfindingStrategy(NULL); // Bound to the previous network
+    _trains.clear();
+    _scheduled = false;
+    
+    _network = network.clone();
+    for (size_t i = 0; i < trains.size(); ++i) {
+        addTrain(trains[i]->clone(_network));
     }
+    _ownsScenario = true;
+}
+
+void SimulationManager::scheduleEvent(IEvent* event, Tick start, Tick end) {
+    _events.schedule(event, start, end);
+}
+
+void SimulationManager::releaseScenario() {
+    if (!_ownsScenario) {
+        return;
+    }
+    
+    // Pending events may point at the copies; trains unbind before they go
+    _events.clear();
+    _stateStore.unbind();
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        delete _trains[i];
+    }
+    _trains.clear();
+    
+    // The pathfinder and this simulation may listen to the network
+    stopListening();
+    releaseRerouters();
+    delete _pathfinder;
+    _pathfinder = NULL;
+    delete _network;
+    _network = NULL;
+    _ownsScenario = false;
 }
 
 void SimulationManager::setPathfindingStrategy(IPathfindingStrategy* strategy) {
@@ -47,33 +221,55 @@ void SimulationManager::setPathfindingStrategy(IPathfindingStrategy* strategy) {
     _pathfinder = strategy;
 }
 
+void SimulationManager::setRerouting(bool enabled) {
+    _rerouting = enabled;
+    if (!enabled) {
+        stopListening();
+    }
+}
+
+void SimulationManager::releaseRerouters() {
+    for (size_t i = 0; i < _rerouters.size(); ++i) {
+        delete _rerouters[i];
+    }
+    _rerouters.clear();
+}
+
+void SimulationManager::stopListening() {
+    if (_listening && _network != NULL) {
+        _network->removeListener(this);
+    }
+    _listening = false;
+}
+
+void SimulationManager::setStepBounds(Tick minStep, Tick maxStep) {
+    _minStep = std::max<Tick>(1, minStep);
+    _maxStep = std::max(_minStep, maxStep);
+}
+
 void SimulationManager::initialize() {
     if (_pathfinder == NULL) {
-        _pathfinder = new DijkstraPathfinding();
+        _pathfinder = new DijkstraPathfinding(_network);
+    }
+    
+    // Build the CSR snapshot before any worker thread reads it
+    if (_network != NULL) {
+        _network->getGraph();
     }
     
     // Find paths for all trains
+    std::vector<std::vector<Node*> > routes;
+    if (_routingMode == ROUTING_SHARED_TREES && _network != NULL) {
+        computeRoutesFromTrees(routes);
+    } else {
+        computeRoutes(routes);
+    }
+    
     for (size_t i = 0; i < _trains.size(); ++i) {
-        Train* train = _trains[i];
-        std::vector<Node*> path = _pathfinder->findPath(
-            train->getDeparture(),
-            train->getDestination()
-        );
-        
-        if (!path.empty()) {
-            train->setPath(path);
-            
-            // Add train to first rail
-            if (path.size() >= 2) {
-                Rail* firstRail = path[0]->getRailTo(path[1]);
-                if (firstRail != NULL) {
-                    firstRail->addTrain(train);
-                }
-            }
-        }
+        assignRoute(_trains[i], routes[i]);
     }
     
-    // Find earliest departure time
+    // Find earliest departure time; waiting trains read it until they leave
     if (!_trains.empty()) {
         _currentTime = _trains[0]->getDepartureTime();
         for (size_t i = 1; i < _trains.size(); ++i) {
@@ -82,13 +278,270 @@ void SimulationManager::initialize() {
             }
         }
     }
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        if (!_trains[i]->hasArrived()) {
+            _trains[i]->setCurrentTime(_currentTime);
+        }
+    }
+    
+    prepareRun();
+}
+
+void SimulationManager::prepareRun() {
+    _stateStore.bind(_trains);
+    rebuildSchedule();
+    _stepCount = 0;
+    _profiles.assign(_trains.size(), KinematicProfile());
+    _profileHours.assign(_trains.size(), 0.0);
+    
+    delete _stepPool;
+    _stepPool = (_workerThreads != 1) ? new ThreadPool(_workerThreads) : NULL;
+    
+    // Rail-to-trains index of the planned routes
+    _trainsByRail.clear();
+    _divertedByRail.clear();
+    _rerouteCount = 0;
+    if (_rerouting && _network != NULL) {
+        _trainsByRail.resize(_network->getRails().size());
+        _divertedByRail.resize(_network->getRails().size());
+        for (size_t i = 0; i < _trains.size(); ++i) {
+            indexRoute(i, 0);
+        }
+        size_t workers = (_stepPool != NULL) ? _stepPool->getThreadCount() : 1;
+        while (_rerouters.size() < workers) {
+            _rerouters.push_back(new DijkstraPathfinding(_network, SEARCH_BIDIRECTIONAL));
+        }
+        if (!_listening) {
+            _network->addListener(this);
+            _listening = true;
+        }
+    }
+}
+
+void SimulationManager::computeRoutes(std::vector<std::vector<Node*> >& routes) {
+    routes.assign(_trains.size(), std::vector<Node*>());
+    
+    // One strategy per worker thread, falling back to the serial loop when
+    // the strategy cannot be cloned
+    if (_workerThreads != 1 && _trains.size() > 1) {
+        ThreadPool pool(_workerThreads);
+        std::vector<IPathfindingStrategy*> workers(1, _pathfinder);
+        while (workers.size() < pool.getThreadCount()) {
+            IPathfindingStrategy* copy = _pathfinder->clone();
+            if (copy == NULL) {
+                break;
+            }
+            workers.push_back(copy);
+        }
+        
+        bool parallel = (workers.size() == pool.getThreadCount());
+        if (parallel) {
+            RouteTask task(_trains, workers, routes);
+            pool.run(task, _trains.size());
+        }
+        for (size_t i = 1; i < workers.size(); ++i) {
+            delete workers[i];
+        }
+        if (parallel) {
+            return;
+        }
+    }
+    
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        routes[i] = _pathfinder->findPath(_trains[i]->getDeparture(),
+                                          _trains[i]->getDestination());
+    }
+}
+
+void SimulationManager::computeRoutesFromTrees(std::vector<std::vector<Node*> >& routes) {
+    routes.assign(_trains.size(), std::vector<Node*>());
+    
+    // Group trains by departure node
+    std::map<Node*, std::vector<size_t> > byOrigin;
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        if (_trains[i]->getDeparture() != NULL && _trains[i]->getDestination() != NULL) {
+            byOrigin[_trains[i]->getDeparture()].push_back(i);
+        }
+    }
+    std::vector<std::pair<Node*, std::vector<size_t> > > origins(byOrigin.begin(),
+                                                                 byOrigin.end());
+    
+    ThreadPool pool(_workerThreads);
+    TreeTask task(_trains, origins, _network, pool.getThreadCount(), routes);
+    pool.run(task, origins.size());
+}
+
+void SimulationManager::assignRoute(Train* train, const std::vector<Node*>& path) {
+    if (path.empty()) {
+        return;
+    }
+    
+    train->setPath(path);
+    
+    // Add train to first rail
+    if (path.size() >= 2) {
+        Rail* firstRail = (_network != NULL)
+                        ? _network->getGraph().findRail(path[0]->getId(), path[1]->getId())
+                        : path[0]->getRailTo(path[1]);
+        if (firstRail != NULL) {
+            firstRail->addTrain(train);
+        }
+    }
 }
 
 bool SimulationManager::isComplete() const {
+    if (_scheduled) {
+        return _arrivedCount == _trains.size();
+    }
     for (size_t i = 0; i < _trains.size(); ++i) {
-        if (!_trains[i]->hasArrived()) {
+        if (!_trains[i]->hasArrived() && _trains[i]->getSegmentCount() > 0) {
             return false;
         }
     }
     return true;
 }
+
+void SimulationManager::indexRoute(size_t index, size_t fromSegment) {
+    Train* train = _trains[index];
+    for (size_t s = fromSegment; s < train->getSegmentCount(); ++s) {
+        const Rail* rail = train->getSegmentRail(s);
+        if (rail != NULL) {
+            _trainsByRail[rail->getId()].push_back(index);
+        }
+    }
+}
+
+size_t SimulationManager::reroutePoint(size_t index) const {
+    const Train* train = _trains[index];
+    
+    // Not yet departed: the whole route may change
+    if (train->getState() == STATE_STOPPED && train->isAtStation()) {
+        return train->getCurrentPathIndex();
+    }
+    // Otherwise the train finishes its current rail first
+    return train->getCurrentPathIndex() + 1;
+}
+
+void SimulationManager::reroute(const std::vector<size_t>& indices, Rail* cause) {
+    // Trains re-routed between the same nodes share one search
+    std::vector<size_t> from(indices.size());
+    std::vector<size_t> queryOf(indices.size(), static_cast<size_t>(-1));
+    std::vector<std::pair<Node*, Node*> > queries;
+    std::map<std::pair<Node*, Node*>, size_t> seen;
+    for (size_t k = 0; k < indices.size(); ++k) {
+        const Train* train = _trains[indices[k]];
+        from[k] = reroutePoint(indices[k]);
+        if (from[k] + 1 >= train->getPath().size()) {
+            continue; // On its last rail
+        }
+        std::pair<Node*, Node*> ends(train->getPath()[from[k]], train->getDestination());
+        std::map<std::pair<Node*, Node*>, size_t>::iterator it = seen.find(ends);
+        if (it == seen.end()) {
+            it = seen.insert(std::make_pair(ends, queries.size())).first;
+            queries.push_back(ends);
+        }
+        queryOf[k] = it->second;
+    }
+    
+    // Rebuild the CSR snapshot with the new weight before the searches read it
+    _network->getGraph();
+    
+    std::vector<std::vector<Node*> > routes(queries.size());
+    RerouteTask task(queries, _rerouters, routes);
+    if (_stepPool != NULL && queries.size() > 1) {
+        _stepPool->run(task, queries.size());
+    } else {
+        for (size_t q = 0; q < queries.size(); ++q) {
+            task.execute(q, 0);
+        }
+    }
+    
+    // Applied in train order, whatever the thread count
+    for (size_t k = 0; k < indices.size(); ++k) {
+        if (queryOf[k] < routes.size()) {
+            applyRoute(indices[k], from[k], routes[queryOf[k]], cause);
+        }
+    }
+}
+
+bool SimulationManager::applyRoute(size_t index, size_t from,
+                                   const std::vector<Node*>& route, Rail* cause) {
+    Train* train = _trains[index];
+    
+    // Keep the old route on ties, or when nothing better exists (the
+    // train then waits for the rail to reopen)
+    if (route.size() < 2 || routeCost(route, 0) >= routeCost(train->getPath(), from)) {
+        return false;
+    }
+    if (!train->replaceRouteFrom(from, route)) {
+        return false;
+    }
+    
+    indexRoute(index, from);
+    if (cause != NULL) {
+        _divertedByRail[cause->getId()].push_back(index);
+    }
+    if (index < _profiles.size()) {
+        _profiles[index].clear();
+    }
+    if (_engine != NULL) {
+        _engine->routeChanged(train);
+    }
+    _rerouteCount++;
+    notify("REROUTE: " + train->getName() + " from " + route[0]->getName());
+    return true;
+}
+
+void SimulationManager::onRailAdded(Rail* rail) {
+    size_t count = static_cast<size_t>(rail->getId()) + 1;
+    if (count > _trainsByRail.size()) {
+        _trainsByRail.resize(count);
+        _divertedByRail.resize(count);
+    }
+}
+
+void SimulationManager::onSpeedLimitChanged(Rail* rail, double oldSpeedLimit) {
+    size_t id = static_cast<size_t>(rail->getId());
+    if (id >= _trainsByRail.size()) {
+        return;
+    }
+    
+    // Faster again: offer the diverted trains their old way back
+    if (rail->getSpeedLimit() > oldSpeedLimit) {
+        std::vector<size_t> diverted;
+        diverted.swap(_divertedByRail[id]);
+        std::sort(diverted.begin(), diverted.end());
+        diverted.erase(std::unique(diverted.begin(), diverted.end()), diverted.end());
+        
+        std::vector<size_t> running;
+        for (size_t k = 0; k < diverted.size(); ++k) {
+            if (!_trains[diverted[k]]->hasArrived()) {
+                running.push_back(diverted[k]);
+            }
+        }
+        reroute(running, NULL);
+        return;
+    }
+    
+    // Slower or closed: only trains with the rail still ahead; entries
+    // the trains have passed, or left by earlier re-routes, are dropped
+    std::vector<size_t>& indexed = _trainsByRail[id];
+    std::sort(indexed.begin(), indexed.end());
+    indexed.erase(std::unique(indexed.begin(), indexed.end()), indexed.end());
+    
+    std::vector<size_t> affected;
+    for (size_t k = 0; k < indexed.size(); ++k) {
+        Train* train = _trains[indexed[k]];
+        if (train->hasArrived()) {
+            continue;
+        }
+        for (size_t s = reroutePoint(indexed[k]); s < train->getSegmentCount(); ++s) {
+            if (train->getSegmentRail(s) == rail) {
+                affected.push_back(indexed[k]);
+                break;
+            }
+        }
+    }
+    indexed = affected;
+    reroute(affected, rail);
+}
@@ -1,121 +1,521 @@
 #include "../incl/SimulationManager.hpp"
+#include "../incl/DiscreteEventEngine.hpp"
+#include "../incl/ThreadPool.hpp"
 #include <cmath>
 #include <algorithm>
+#include <limits>
+
+namespace {
+
+const size_t INTEGRATE_BLOCK = 1024;     // Slots per integrate() task, kept even for SSE2
+const double NO_LEADER = std::numeric_limits<double>::max();
+const double STEP_SPEED_CHANGE = 0.1;    // Adaptive step: largest speed change, share of the speed
+
+// Min-heap order of (departure, train index)
+struct LaterDeparture {
+    bool operator()(const std::pair<Tick, size_t>& a, const std::pair<Tick, size_t>& b) const {
+        return a > b;
+    }
+};
+
+} // namespace
+
+/**
+ * One parallel phase of step(); every index writes only its own trains
+ */
+class SimulationManager::StepTask : public IParallelTask {
+public:
+    enum Phase {
+        PLAN,        // One train per index
+        INTEGRATE    // INTEGRATE_BLOCK slots per index
+    };
+
+private:
+    SimulationManager& _manager;
+    Phase _phase;
+    double _stepHours;
+
+public:
+    StepTask(SimulationManager& manager, Phase phase, double stepHours)
+        : _manager(manager), _phase(phase), _stepHours(stepHours) {}
+
+    size_t getCount() const {
+        return (_phase == PLAN) ? _manager._active.size() : _manager._activeBlocks.size();
+    }
+
+    void runOn(ThreadPool* pool) {
+        if (pool != NULL) {
+            pool->run(*this, getCount());
+            return;
+        }
+        for (size_t i = 0; i < getCount(); ++i) {
+            execute(i, 0);
+        }
+    }
+
+    virtual void execute(size_t index, size_t worker) {
+        (void)worker;
+        if (_phase == PLAN) {
+            _manager.planTrain(_manager._active[index], _stepHours);
+        } else {
+            size_t block = _manager._activeBlocks[index];
+            _manager._stateStore.integrate(block * INTEGRATE_BLOCK,
+                                           (block + 1) * INTEGRATE_BLOCK,
+                                           _stepHours);
+        }
+    }
+};
 
 // Additional methods for SimulationManager.cpp - append to previous file
 
 void SimulationManager::step() {
+    if (!_scheduled || _stateStore.size() != _trains.size()) {
+        prepareRun();
+    }
+    applyEvents();
+    releaseDepartures();
+    sweepRails();
+    _step = _adaptiveStep ? chooseStep() : _timeStep;
+    
     updateTrains();
     checkCollisions();
     handleTrainInteractions();
+    retireArrived();
+    
+    _currentTime += _step;
     
-    _currentTime.addMinutes(_timeStepMinutes);
+    StepView view(_network, _trains, _active, _stepCount, _currentTime, _step);
+    for (size_t i = 0; i < _stepObservers.size(); ++i) {
+        _stepObservers[i]->onStep(view);
+    }
+    _stepCount++;
 }
 
-void SimulationManager::run() {
-    const int maxSteps = 10000; // Safety limit
-    int steps = 0;
-    
-    while (!isComplete() && steps < maxSteps) {
-        step();
-        steps++;
+void SimulationManager::addStepObserver(IStepObserver* observer) {
+    if (observer != NULL) {
+        _stepObservers.push_back(observer);
     }
 }
 
-void SimulationManager::updateTrains() {
+void SimulationManager::removeStepObserver(IStepObserver* observer) {
+    std::vector<IStepObserver*>::iterator it = std::find(_stepObservers.begin(),
+                                                         _stepObservers.end(), observer);
+    if (it != _stepObservers.end()) {
+        _stepObservers.erase(it);
+    }
+}
+
+void SimulationManager::rebuildSchedule() {
+    _departures.clear();
+    _active.clear();
+    _departing.assign(_trains.size(), 0);
+    _leaderGaps.assign(_trains.size(), NO_LEADER);
+    _pendingTravelled.assign(_trains.size(), -1.0);
+    _arrivedCount = 0;
+    
     for (size_t i = 0; i < _trains.size(); ++i) {
         Train* train = _trains[i];
+        if (train->hasArrived() || train->getSegmentCount() == 0) {
+            _arrivedCount++; // A train without a route never leaves
+        } else if (train->getState() == STATE_STOPPED && train->isAtStation()) {
+            _departures.push_back(std::make_pair(train->getDepartureTime(), i));
+        } else {
+            _active.push_back(i);
+        }
+    }
+    std::make_heap(_departures.begin(), _departures.end(), LaterDeparture());
+    _scheduled = true;
+}
+
+void SimulationManager::releaseDepartures() {
+    size_t activeCount = _active.size();
+    
+    while (!_departures.empty()) {
+        std::pair<Tick, size_t> next = _departures.front();
+        Tick departure = _trains[next.second]->getDepartureTime();
+        if (next.first > _currentTime && next.first == departure) {
+            break;
+        }
         
-        // Check if train should depart
-        if (train->getState() == STATE_STOPPED && 
-            train->getCurrentTime() < train->getDepartureTime() &&
-            _currentTime == train->getDepartureTime()) {
-            train->setState(STATE_ACCELERATING);
+        std::pop_heap(_departures.begin(), _departures.end(), LaterDeparture());
+        _departures.pop_back();
+        
+        // Delayed while waiting: queue again at the new time
+        if (next.first != departure) {
+            _departures.push_back(std::make_pair(departure, next.second));
+            std::push_heap(_departures.begin(), _departures.end(), LaterDeparture());
+            continue;
+        }
+        _departing[next.second] = 1;
+        _active.push_back(next.second);
+    }
+    
+    if (_active.size() != activeCount) {
+        std::sort(_active.begin() + activeCount, _active.end());
+        std::inplace_merge(_active.begin(), _active.begin() + activeCount, _active.end());
+    }
+    
+    _activeBlocks.clear();
+    for (size_t k = 0; k < _active.size(); ++k) {
+        size_t block = _active[k] / INTEGRATE_BLOCK;
+        if (_activeBlocks.empty() || _activeBlocks.back() != block) {
+            _activeBlocks.push_back(block);
+        }
+    }
+}
+
+void SimulationManager::retireArrived() {
+    _stateStore.endStep(_active);
+    
+    size_t kept = 0;
+    for (size_t k = 0; k < _active.size(); ++k) {
+        if (_trains[_active[k]]->hasArrived()) {
+            _arrivedCount++;
+        } else {
+            _active[kept++] = _active[k];
+        }
+    }
+    _active.resize(kept);
+}
+
+void SimulationManager::applyEvents() {
+    if (_events.empty() || _events.nextTime() > _currentTime) {
+        return;
+    }
+    
+    // Running trains' clocks read the event time (holds count from it)
+    for (size_t k = 0; k < _active.size(); ++k) {
+        Train* train = _trains[_active[k]];
+        if (train->getState() != STATE_STOPPED) {
+            train->setCurrentTime(_currentTime);
         }
+    }
+    _events.processUntil(_currentTime, this);
+    
+    // Speed limits may have changed under the analytic profiles
+    for (size_t i = 0; i < _profiles.size(); ++i) {
+        _profiles[i].clear();
+    }
+}
+
+Tick SimulationManager::chooseStep() const {
+    const double safetyDistance = 2.0; // km, same as updateTrains
+    double step = static_cast<double>(_maxStep);
+    
+    // Do not step over a scheduled event
+    if (!_events.empty() && _events.nextTime() > _currentTime) {
+        step = std::min(step, static_cast<double>(_events.nextTime() - _currentTime));
+    }
+    
+    // Nor over a departure (releaseDepartures() left the heap top current)
+    if (!_departures.empty() && _departures.front().first > _currentTime) {
+        step = std::min(step, static_cast<double>(_departures.front().first - _currentTime));
+    }
+    
+    for (size_t k = 0; k < _active.size(); ++k) {
+        size_t i = _active[k];
+        Train* train = _trains[i];
         
-        train->setCurrentTime(_currentTime);
+        // Stopped by a collision; trains released this step start from rest
+        bool departing = _departing[i] != 0;
+        if (train->getState() == STATE_STOPPED && !departing) {
+            continue;
+        }
         
-        if (train->getState() == STATE_STOPPED) {
+        // A held train waits for the end of its hold
+        if (train->getHoldUntil() > _currentTime) {
+            step = std::min(step, static_cast<double>(train->getHoldUntil() - _currentTime));
             continue;
         }
         
-        // Get current rail and speed limit
         const Position& pos = train->getPosition();
         if (pos.currentRail == NULL) {
             continue;
         }
         
-        double speedLimit = pos.currentRail->getSpeedLimit();
-        double currentSpeed = train->getCurrentSpeed();
+        // Nearest critical distance ahead of this train
+        double speed = departing ? 0.0 : train->getCurrentSpeed();
+        double braking = train->calculateBraking();
+        double limit = pos.currentRail->getSpeedLimit();
+        double railLeft = pos.currentRail->getLength() - pos.distanceOnRail;
+        double critical = railLeft;
         
-        // Check for train ahead
-        Train* trainAhead = pos.currentRail->getTrainAhead(train, pos.distanceOnRail);
-        bool needBraking = false;
+        double gap = _leaderGaps[i];
+        if (gap != NO_LEADER) {
+            critical = std::min(critical, (gap > safetyDistance) ? gap - safetyDistance : 0.0);
+        }
         
-        if (trainAhead != NULL) {
-            const Position& aheadPos = trainAhead->getPosition();
-            double distance = aheadPos.distanceOnRail - pos.distanceOnRail;
-            
-            // Safety distance: 2 km
-            if (distance < 2.0) {
-                needBraking = true;
-            }
+        // Acceleration of the stepped rule (TrainStateStore) over the step
+        const double zone = TrainStateStore::BRAKING_ZONE;
+        double stoppingDistance = TrainStateStore::stoppingDistance(speed, braking);
+        double accel = 0.0;
+        if ((railLeft < stoppingDistance && railLeft < zone) ||
+            (gap != NO_LEADER && gap < safetyDistance)) {
+            accel = -braking;
+        } else if (speed < limit * TrainStateStore::CRUISE_FRACTION) {
+            accel = train->calculateTractiveAcceleration();
         }
         
-        // Update state and speed based on conditions
-        if (needBraking) {
-            train->setState(STATE_BRAKING);
-            double braking = train->calculateBraking();
-            double newSpeed = std::max(0.0, currentSpeed - braking * (_timeStepMinutes / 60.0));
-            train->setCurrentSpeed(newSpeed);
-        } else if (currentSpeed < speedLimit * 0.95) {
-            train->setState(STATE_ACCELERATING);
-            double accel = train->calculateAcceleration(speedLimit);
-            double newSpeed = std::min(speedLimit, currentSpeed + accel * (_timeStepMinutes / 60.0));
-            train->setCurrentSpeed(newSpeed);
-        } else {
-            train->setState(STATE_MAINTAINING);
-            train->setCurrentSpeed(std::min(speedLimit, currentSpeed));
+        // Braking starts within the zone once the stopping distance, which
+        // grows while accelerating, reaches the rail end
+        double brakePoint = railLeft - ((accel > 0.0) ? zone : std::min(stoppingDistance, zone));
+        if (brakePoint > 0.0) {
+            critical = std::min(critical, brakePoint);
+        }
+        
+        if (critical <= 0.0 || (speed <= 0.0 && accel <= 0.0)) {
+            step = static_cast<double>(_minStep);
+            break;
         }
         
-        // Check if approaching end of rail (need to brake)
-        double distanceRemaining = pos.currentRail->getLength() - pos.distanceOnRail;
-        double stoppingDistance = (currentSpeed * currentSpeed) / (2.0 * train->calculateBraking() / 3.6);
+        // Time to cover the critical distance: v*t + a*t^2/2 = critical,
+        // or the time to stop if braking ends short of it
+        double disc = speed * speed + 2.0 * accel * critical;
+        double hours = (disc >= 0.0) ? 2.0 * critical / (speed + std::sqrt(disc))
+                                     : speed / -accel;
+        step = std::min(step, hours * TICKS_PER_HOUR);
         
-        if (distanceRemaining < stoppingDistance && distanceRemaining < 5.0) {
-            train->setState(STATE_BRAKING);
-            double braking = train->calculateBraking();
-            double newSpeed = std::max(0.0, currentSpeed - braking * (_timeStepMinutes / 60.0));
-            train->setCurrentSpeed(newSpeed);
+        // The stepped update moves at the end-of-step speed, overshooting
+        // by a*t^2/2: keep the speed change of a step within a share of
+        // the speed (or within one minimum step from rest)
+        if (accel != 0.0) {
+            double change = std::max(STEP_SPEED_CHANGE * speed,
+                                     std::fabs(accel) * _minStep / TICKS_PER_HOUR);
+            step = std::min(step, change / std::fabs(accel) * TICKS_PER_HOUR);
+        }
+    }
+    
+    return std::max(_minStep, std::min(_maxStep, static_cast<Tick>(std::floor(step))));
+}
+
+void SimulationManager::run() {
+    if (_steppingMode == STEPPING_EVENT_DRIVEN) {
+        runEventDriven();
+        return;
+    }
+    
+    size_t steps = 0;
+    while (!isComplete() && steps < _maxSteps) {
+        step();
+        steps++;
+    }
+}
+
+void SimulationManager::runEventDriven() {
+    const size_t maxEvents = 1000000; // Safety limit
+    
+    DiscreteEventEngine engine(_trains, this);
+    engine.setScheduler(&_events);
+    _engine = &engine;
+    _currentTime = engine.run(_currentTime, maxEvents);
+    _engine = NULL;
+    rebuildSchedule();
+}
+
+void SimulationManager::updateTrains() {
+    double stepHours = static_cast<double>(_step) / TICKS_PER_HOUR;
+    
+    // Compute phase: new speeds and positions from the previous step's state
+    StepTask plan(*this, StepTask::PLAN, stepHours);
+    plan.runOn(_stepPool);
+    StepTask integrate(*this, StepTask::INTEGRATE, stepHours);
+    integrate.runOn(_stepPool);
+    
+    // Commit phase: rail transfers in train order
+    for (size_t k = 0; k < _active.size(); ++k) {
+        size_t i = _active[k];
+        if (_pendingTravelled[i] >= 0.0) {
+            _trains[i]->moveTo(_pendingTravelled[i]);
+            _pendingTravelled[i] = -1.0;
+        } else if (_stateStore.reachedRailEnd(i)) {
+            _trains[i]->advance(_stateStore.getStepDistance(i));
         }
+    }
+}
+
+void SimulationManager::planTrain(size_t index, double stepHours) {
+    Train* train = _trains[index];
+    
+    // Depart on the first step at or after the scheduled time
+    if (_departing[index]) {
+        _departing[index] = 0;
+        train->setState(STATE_ACCELERATING);
+    }
+    
+    // An arrived train keeps its arrival time
+    if (train->hasArrived()) {
+        return;
+    }
+    train->setCurrentTime(_currentTime);
+    
+    if (train->getState() == STATE_STOPPED) {
+        return;
+    }
+    
+    // Held by a DelayEvent: wait in place
+    if (_currentTime < train->getHoldUntil()) {
+        train->setCurrentSpeed(0.0);
+        train->setState(STATE_WAITING);
+        if (index < _profiles.size()) {
+            _profiles[index].clear();
+        }
+        return;
+    }
+    
+    // Get current rail and speed limit
+    const Position& pos = train->getPosition();
+    if (pos.currentRail == NULL) {
+        return;
+    }
+    
+    bool needBraking = isInteracting(index);
+    
+    // A lone train follows its closed-form profile
+    if (_steppingMode == STEPPING_ANALYTIC && index < _profiles.size()) {
+        if (!needBraking) {
+            planAnalytic(index, stepHours);
+            return;
+        }
+        _profiles[index].clear(); // Re-planned once the train is alone again
+    }
+    
+    _stateStore.prepare(index, pos.currentRail->getLength(),
+                        pos.currentRail->getSpeedLimit(), needBraking);
+}
+
+void SimulationManager::collectActiveRails() {
+    // Only rails under a departed train can hold a leader or a collision;
+    // a pass number marks rails already listed without clearing the marks
+    _activeRails.clear();
+    if (_network == NULL) {
+        return;
+    }
+    if (_railStamp.size() < _network->getRails().size()) {
+        _railStamp.resize(_network->getRails().size(), 0u);
+    }
+    _railPass++;
+    if (_railPass == 0) {
+        std::fill(_railStamp.begin(), _railStamp.end(), 0u);
+        _railPass = 1;
+    }
+    
+    for (size_t k = 0; k < _active.size(); ++k) {
+        const Rail* rail = _trains[_active[k]]->getPosition().currentRail;
+        if (rail == NULL) {
+            continue;
+        }
+        size_t id = static_cast<size_t>(rail->getId());
+        if (id < _railStamp.size() && _railStamp[id] != _railPass) {
+            _railStamp[id] = _railPass;
+            _activeRails.push_back(id);
+        }
+    }
+    std::sort(_activeRails.begin(), _activeRails.end()); // Rail order, as a full sweep
+}
+
+void SimulationManager::sweepRails() {
+    // Only departed trains read their gap
+    for (size_t k = 0; k < _active.size(); ++k) {
+        _leaderGaps[_active[k]] = NO_LEADER;
+    }
+    collectActiveRails();
+    if (_activeRails.empty()) {
+        return;
+    }
+    
+    // Leader of each train is its next neighbour on the sorted rail, if it
+    // entered from the same node: opposite directions never close in
+    // on each other
+    const std::vector<Rail*>& rails = _network->getRails();
+    for (size_t a = 0; a < _activeRails.size(); ++a) {
+        Rail* rail = rails[_activeRails[a]];
+        if (rail->getOccupyingTrains().size() < 2) {
+            continue;
+        }
+        rail->sortOccupants();
         
-        // Update position
-        train->updatePosition(_timeStepMinutes);
+        const std::vector<Train*>& occupants = rail->getOccupyingTrains();
+        for (size_t k = 0; k + 1 < occupants.size(); ++k) {
+            Train* leader = occupants[k + 1];
+            size_t slot = occupants[k]->getStateSlot();
+            if (leader->getPosition().lastNode != occupants[k]->getPosition().lastNode) {
+                continue; // Front of its direction
+            }
+            if (leader->hasArrived() || slot >= _leaderGaps.size() ||
+                _trains[slot] != occupants[k]) {
+                continue; // Arrived trains are parked at the station
+            }
+            _leaderGaps[slot] = leader->getPosition().distanceOnRail -
+                                occupants[k]->getPosition().distanceOnRail;
+        }
     }
 }
 
+bool SimulationManager::isInteracting(size_t index) const {
+    // Safety distance: 2 km
+    return _leaderGaps[index] < 2.0;
+}
+
+void SimulationManager::planAnalytic(size_t index, double hours) {
+    Train* train = _trains[index];
+    KinematicProfile& profile = _profiles[index];
+    
+    if (profile.empty()) {
+        profile.build(*train);
+        _profileHours[index] = 0.0;
+    }
+    _profileHours[index] += hours;
+    
+    double travelled;
+    double speed;
+    TrainState state;
+    profile.sample(_profileHours[index], travelled, speed, state);
+    
+    train->setCurrentSpeed(speed);
+    train->setState(state);
+    _pendingTravelled[index] = travelled;
+}
+
 void SimulationManager::checkCollisions() {
-    // Simple collision detection
-    for (size_t i = 0; i < _trains.size(); ++i) {
-        const Position& pos1 = _trains[i]->getPosition();
-        if (pos1.currentRail == NULL) continue;
+    if (_network == NULL) {
+        return;
+    }
+    
+    // Only trains within 100 m of each other in the same direction on a
+    // rail collide; once the rail is sorted they sit next to each other.
+    // Trains changed rails during the step, so list the rails again
+    collectActiveRails();
+    const std::vector<Rail*>& rails = _network->getRails();
+    for (size_t a = 0; a < _activeRails.size(); ++a) {
+        Rail* rail = rails[_activeRails[a]];
+        if (rail->getOccupyingTrains().size() < 2) {
+            continue;
+        }
+        rail->sortOccupants();
         
-        for (size_t j = i + 1; j < _trains.size(); ++j) {
-            const Position& pos2 = _trains[j]->getPosition();
+        const std::vector<Train*>& occupants = rail->getOccupyingTrains();
+        for (size_t k = 0; k < occupants.size(); ++k) {
+            Train* rear = occupants[k];
+            if (rear->isAtStation()) continue;
+            double rearDistance = rear->getPosition().distanceOnRail;
             
-            if (pos1.currentRail == pos2.currentRail) {
-                double distance = std::abs(pos1.distanceOnRail - pos2.distanceOnRail);
-                
-                if (distance < 0.1) { // 100 meters
-                    // Collision detected - stop both trains
-                    _trains[i]->setState(STATE_STOPPED);
-                    _trains[i]->setCurrentSpeed(0.0);
-                    _trains[j]->setState(STATE_STOPPED);
-                    _trains[j]->setCurrentSpeed(0.0);
-                    
-                    notify("COLLISION: " + _trains[i]->getName() + 
-                           " and " + _trains[j]->getName());
+            for (size_t m = k + 1; m < occupants.size(); ++m) {
+                Train* front = occupants[m];
+                if (front->getPosition().lastNode != rear->getPosition().lastNode ||
+                    front->getPosition().distanceOnRail - rearDistance >= 0.1) {
+                    break; // Other direction, or beyond 100 meters
                 }
+                if (front->isAtStation()) continue;
+                
+                // Collision detected - stop both trains
+                rear->setState(STATE_STOPPED);
+                rear->setCurrentSpeed(0.0);
+                front->setState(STATE_STOPPED);
+                front->setCurrentSpeed(0.0);
+                
+                bool rearFirst = rear->getStateSlot() < front->getStateSlot();
+                notify("COLLISION: " + (rearFirst ? rear : front)->getName() +
+                       " and " + (rearFirst ? front : rear)->getName());
             }
         }
     }
@@ -0,0 +1,141 @@
+#include "../incl/ThreadPool.hpp"
+#include <unistd.h>
+#include <algorithm>
+
+namespace {
+
+struct WorkerStart {
+    ThreadPool* pool;
+    size_t worker;
+};
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : _task(NULL), _count(0), _next(0), _chunk(1), _busy(0),
+      _generation(0), _stop(false) {
+    if (threadCount == 0) {
+        threadCount = hardwareThreads();
+    }
+    
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_workReady, NULL);
+    pthread_cond_init(&_workDone, NULL);
+    
+    for (size_t i = 1; i < threadCount; ++i) {
+        WorkerStart* start = new WorkerStart();
+        start->pool = this;
+        start->worker = i;
+        
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &ThreadPool::workerEntry, start) != 0) {
+            delete start;
+            break; // Run with the threads we could get
+        }
+        _threads.push_back(thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock(&_mutex);
+    _stop = true;
+    pthread_cond_broadcast(&_workReady);
+    pthread_mutex_unlock(&_mutex);
+    
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        pthread_join(_threads[i], NULL);
+    }
+    
+    pthread_cond_destroy(&_workDone);
+    pthread_cond_destroy(&_workReady);
+    pthread_mutex_destroy(&_mutex);
+}
+
+size_t ThreadPool::hardwareThreads() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cores > 0) ? static_cast<size_t>(cores) : 1;
+}
+
+void* ThreadPool::workerEntry(void* arg) {
+    WorkerStart* start = static_cast<WorkerStart*>(arg);
+    ThreadPool* pool = start->pool;
+    size_t worker = start->worker;
+    delete start;
+    
+    pool->workerLoop(worker);
+    return NULL;
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+    unsigned int seen = 0;
+    
+    pthread_mutex_lock(&_mutex);
+    while (true) {
+        while (!_stop && _generation == seen) {
+            pthread_cond_wait(&_workReady, &_mutex);
+        }
+        if (_stop) {
+            break;
+        }
+        seen = _generation;
+        pthread_mutex_unlock(&_mutex);
+        
+        drain(worker);
+        
+        pthread_mutex_lock(&_mutex);
+        if (--_busy == 0) {
+            pthread_cond_signal(&_workDone);
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+void ThreadPool::drain(size_t worker) {
+    while (true) {
+        pthread_mutex_lock(&_mutex);
+        size_t begin = _next;
+        size_t end = std::min(_count, begin + _chunk);
+        _next = end;
+        pthread_mutex_unlock(&_mutex);
+        
+        if (begin >= end) {
+            return;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            _task->execute(i, worker);
+        }
+    }
+}
+
+void ThreadPool::run(IParallelTask& task, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    
+    if (_threads.empty()) {
+        for (size_t i = 0; i < count; ++i) {
+            task.execute(i, 0);
+        }
+        return;
+    }
+    
+    pthread_mutex_lock(&_mutex);
+    _task = &task;
+    _count = count;
+    _next = 0;
+    // A few chunks per worker keeps the lock cold while balancing load
+    _chunk = std::max(static_cast<size_t>(1), count / (getThreadCount() * 8));
+    _busy = _threads.size();
+    _generation++;
+    pthread_cond_broadcast(&_workReady);
+    pthread_mutex_unlock(&_mutex);
+    
+    drain(0);
+    
+    pthread_mutex_lock(&_mutex);
+    while (_busy > 0) {
+        pthread_cond_wait(&_workDone, &_mutex);
+    }
+    _task = NULL;
+    pthread_mutex_unlock(&_mutex);
+}
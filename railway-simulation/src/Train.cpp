@@ -1,53 +1,161 @@
 #include "../incl/Train.hpp"
+#include "../incl/RailwayNetwork.hpp"
 #include <cmath>
 #include <algorithm>
 
-int Train::_nextId = 1;
-
 Train::Train(const std::string& name, double weight, double friction,
              double maxAccel, double maxBrake, Node* dep, Node* dest,
-             const Time& depTime, const Time& stopDur)
-    : _id(_nextId++), _name(name), _weight(weight), _frictionCoeff(friction),
+             Tick depTime, Tick stopDur)
+    : _id(0), _name(name), _weight(weight), _frictionCoeff(friction),
       _maxAccelForce(maxAccel), _maxBrakeForce(maxBrake),
       _departure(dep), _destination(dest), _departureTime(depTime),
-      _stopDuration(stopDur), _state(STATE_STOPPED), _currentSpeed(0.0),
-      _currentPathIndex(0), _currentTime(depTime), _totalDistanceToGo(0.0) {
+      _stopDuration(stopDur), _store(NULL), _slot(0), _state(STATE_STOPPED), _currentSpeed(0.0),
+      _routeLength(0.0), _currentPathIndex(0), _currentTime(depTime), _holdUntil(0) {
+    _position.currentRail = NULL;
+    _position.lastNode = NULL;
+    _position.nextNode = NULL;
+    _position.distanceOnRail = 0.0;
 }
 
 Train::~Train() {
 }
 
+Train* Train::clone(const RailwayNetwork* network) const {
+    Node* departure = (_departure != NULL) ? network->getNodeById(_departure->getId()) : NULL;
+    Node* destination = (_destination != NULL) ? network->getNodeById(_destination->getId()) : NULL;
+    
+    Train* copy = new Train(_name, _weight, _frictionCoeff, _maxAccelForce, _maxBrakeForce,
+                            departure, destination, _departureTime, _stopDuration);
+    copy->_id = _id;
+    return copy;
+}
+
 void Train::setPath(const std::vector<Node*>& path) {
     _path = path;
     _currentPathIndex = 0;
-    updateTotalDistance();
+    
+    _segments.clear();
+    _routeLength = 0.0;
+    appendSegments(0);
     
     // Initialize position
-    if (_path.size() >= 2) {
+    _position.currentRail = NULL;
+    _position.lastNode = NULL;
+    _position.nextNode = NULL;
+    setDistanceOnRail(0.0);
+    if (!_segments.empty()) {
         _position.lastNode = _path[0];
         _position.nextNode = _path[1];
-        _position.currentRail = _position.lastNode->getRailTo(_position.nextNode);
-        _position.distanceOnRail = 0.0;
+        _position.currentRail = _segments[0].rail;
     }
 }
 
-void Train::updateTotalDistance() {
-    _totalDistanceToGo = 0.0;
+void Train::restoreProgress(const std::vector<Node*>& path, size_t pathIndex,
+                            double distanceOnRail) {
+    setPath(path);
+    _currentPathIndex = std::min(pathIndex, _segments.size());
     
-    for (size_t i = _currentPathIndex; i < _path.size() - 1; ++i) {
-        Rail* rail = _path[i]->getRailTo(_path[i + 1]);
-        if (rail != NULL) {
-            if (i == _currentPathIndex) {
-                // Subtract already traveled distance on current rail
-                _totalDistanceToGo += rail->getLength() - _position.distanceOnRail;
-            } else {
-                _totalDistanceToGo += rail->getLength();
+    // An arrived train stays at the end of its last rail
+    size_t segment = _currentPathIndex;
+    if (segment >= _segments.size() && segment > 0) {
+        segment--;
+    }
+    if (segment < _segments.size()) {
+        _position.lastNode = _path[segment];
+        _position.nextNode = _path[segment + 1];
+        _position.currentRail = _segments[segment].rail;
+    }
+    setDistanceOnRail(distanceOnRail);
+}
+
+bool Train::replaceRouteFrom(size_t pathIndex, const std::vector<Node*>& route) {
+    if (route.size() < 2 || pathIndex >= _path.size() || route[0] != _path[pathIndex] ||
+        pathIndex < _currentPathIndex) {
+        return false;
+    }
+    
+    _path.resize(pathIndex);
+    _path.insert(_path.end(), route.begin(), route.end());
+    _segments.resize(pathIndex);
+    _routeLength = _segments.empty() ? 0.0
+                 : _segments.back().startOffset + _segments.back().length;
+    appendSegments(pathIndex);
+    
+    // Still at the origin: take the new first rail
+    if (pathIndex == _currentPathIndex) {
+        Rail* prevRail = _position.currentRail;
+        _position.nextNode = _path[pathIndex + 1];
+        _position.currentRail = _segments[pathIndex].rail;
+        if (prevRail != _position.currentRail) {
+            if (prevRail != NULL) {
+                prevRail->removeTrain(this);
+            }
+            if (_position.currentRail != NULL) {
+                _position.currentRail->addTrain(this);
             }
         }
     }
+    return true;
+}
+
+void Train::appendSegments(size_t from) {
+    // Resolve every hop once; later queries only index this table
+    if (_path.size() >= 2) {
+        _segments.reserve(_path.size() - 1);
+    }
+    for (size_t i = from; i + 1 < _path.size(); ++i) {
+        Segment segment;
+        segment.rail = _path[i]->getRailTo(_path[i + 1]);
+        segment.length = (segment.rail != NULL) ? segment.rail->getLength() : 0.0;
+        segment.startOffset = _routeLength;
+        _routeLength += segment.length;
+        _segments.push_back(segment);
+    }
+}
+
+double Train::getTotalDistanceToGo() const {
+    if (_currentPathIndex >= _segments.size()) {
+        return 0.0;
+    }
+    
+    const Segment& segment = _segments[_currentPathIndex];
+    double travelled = segment.startOffset;
+    if (segment.rail != NULL) {
+        travelled += distanceOnRail();
+    }
+    return _routeLength - travelled;
+}
+
+void Train::bindState(TrainStateStore* store, size_t slot) {
+    TrainState state = getState();
+    double speed = getCurrentSpeed();
+    double distance = distanceOnRail();
+    Tick time = getCurrentTime();
+    
+    _store = store;
+    _slot = slot;
+    
+    setState(state);
+    speedRef() = speed;
+    timeRef() = time;
+    setDistanceOnRail(distance);
+}
+
+void Train::setDistanceOnRail(double distance) {
+    if (_store) {
+        _store->distanceAt(_slot) = distance;
+    }
+    _position.distanceOnRail = distance;
 }
 
 double Train::calculateAcceleration(double speedLimit) const {
+    if (getCurrentSpeed() >= speedLimit) {
+        return 0.0;
+    }
+    return calculateTractiveAcceleration();
+}
+
+double Train::calculateTractiveAcceleration() const {
     // F = ma => a = F/m
     // Account for friction: F_net = F_accel - F_friction
     // F_friction = μ * m * g (where g ≈ 9.81 m/s²)
@@ -59,9 +167,6 @@ double Train::calculateAcceleration(double speedLimit) const {
     if (netForce <= 0) {
         return 0.0;
     }
-    if (_currentSpeed >= speedLimit) {
-        return 0.0;
-    }
     
     // a = F/m (m in metric tons, F in kN)
     double accel = netForce / _weight; // km/h per second approximately
@@ -75,7 +180,7 @@ double Train::calculateBraking() const {
 }
 
 void Train::updatePosition(double timeStepMinutes) {
-    if (_state == STATE_STOPPED || _position.currentRail == NULL) {
+    if (getState() == STATE_STOPPED || _position.currentRail == NULL) {
         return;
     }
     
@@ -83,28 +188,34 @@ void Train::updatePosition(double timeStepMinutes) {
     double timeStepHours = timeStepMinutes / 60.0;
     
     // Calculate distance traveled
-    double distance = _currentSpeed * timeStepHours;
+    advance(getCurrentSpeed() * timeStepHours);
+}
+
+void Train::advance(double distance) {
+    if (_position.currentRail == NULL) {
+        return;
+    }
     
-    _position.distanceOnRail += distance;
+    setDistanceOnRail(distanceOnRail() + distance);
     
     // Check if we've reached the end of current rail
     if (_position.distanceOnRail >= _position.currentRail->getLength()) {
-        _position.distanceOnRail = _position.currentRail->getLength();
+        setDistanceOnRail(_position.currentRail->getLength());
         
         // Move to next rail segment
         _currentPathIndex++;
         
-        if (_currentPathIndex >= _path.size() - 1) {
+        if (_currentPathIndex >= _segments.size()) {
             // Arrived at destination
-            _state = STATE_STOPPED;
-            _currentSpeed = 0.0;
+            setState(STATE_STOPPED);
+            speedRef() = 0.0;
         } else {
             // Continue to next segment
             _position.lastNode = _path[_currentPathIndex];
             _position.nextNode = _path[_currentPathIndex + 1];
             
             Rail* prevRail = _position.currentRail;
-            _position.currentRail = _position.lastNode->getRailTo(_position.nextNode);
+            _position.currentRail = _segments[_currentPathIndex].rail;
             
             if (prevRail != NULL) {
                 prevRail->removeTrain(this);
@@ -113,20 +224,50 @@ void Train::updatePosition(double timeStepMinutes) {
                 _position.currentRail->addTrain(this);
             }
             
-            _position.distanceOnRail = 0.0;
+            setDistanceOnRail(0.0);
+        }
+    }
+}
+
+void Train::moveTo(double travelled) {
+    // advance() stops at each rail end, so step one rail at a time
+    while (_position.currentRail != NULL && _currentPathIndex < _segments.size()) {
+        double delta = travelled - getDistanceTravelled();
+        double railLeft = _position.currentRail->getLength() - distanceOnRail();
+        if (delta >= railLeft - 1e-9) {
+            // Rounding in the running sums must not leave a train just
+            // short of a rail end it reached
+            delta = railLeft + 1e-9;
+        }
+        if (delta <= 1e-12) {
+            break;
+        }
+        size_t index = _currentPathIndex;
+        advance(delta);
+        if (_currentPathIndex == index) {
+            break; // Stayed on the same rail
         }
     }
-    
-    updateTotalDistance();
 }
 
 bool Train::hasArrived() const {
-    return (_currentPathIndex >= _path.size() - 1 && 
-            _state == STATE_STOPPED);
+    return (!_segments.empty() && _currentPathIndex >= _segments.size() &&
+            getState() == STATE_STOPPED);
+}
+
+bool Train::isAtStation() const {
+    if (hasArrived()) {
+        return true;
+    }
+    return _currentPathIndex == 0 && distanceOnRail() == 0.0;
 }
 
 std::string Train::getStateString() const {
-    switch (_state) {
+    return getStateName(getState());
+}
+
+const char* Train::getStateName(TrainState state) {
+    switch (state) {
         case STATE_STOPPED: return "Stopped";
         case STATE_ACCELERATING: return "Speed up";
         case STATE_MAINTAINING: return "Maintain";
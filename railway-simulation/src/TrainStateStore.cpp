@@ -0,0 +1,190 @@
+#include "../incl/TrainStateStore.hpp"
+#include "../incl/Train.hpp"
+#include <algorithm>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const double TrainStateStore::CRUISE_FRACTION = 0.95;
+const double TrainStateStore::BRAKING_ZONE = 5.0;
+
+TrainStateStore::TrainStateStore() {
+}
+
+double TrainStateStore::stoppingDistance(double speed, double braking) {
+    if (braking <= 0.0) {
+        return std::numeric_limits<double>::max();
+    }
+    return (speed * speed) / (2.0 * braking / 3.6);
+}
+
+TrainStateStore::~TrainStateStore() {
+    unbind();
+}
+
+void TrainStateStore::bind(const std::vector<Train*>& trains) {
+    unbind();
+
+    size_t count = trains.size();
+    _speed.assign(count, 0.0);
+    _distance.assign(count, 0.0);
+    _state.assign(count, STATE_STOPPED);
+    _time.assign(count, 0);
+    _railLength.assign(count, 0.0);
+    _speedLimit.assign(count, 0.0);
+    _accel.assign(count, 0.0);
+    _brake.assign(count, 0.0);
+    _active.assign(count, 0.0);
+    _brakeAhead.assign(count, 0.0);
+    _stepDistance.assign(count, 0.0);
+    _railEnd.assign(count, 0);
+    _trains = trains;
+
+    for (size_t i = 0; i < count; ++i) {
+        _accel[i] = trains[i]->calculateTractiveAcceleration();
+        _brake[i] = trains[i]->calculateBraking();
+        trains[i]->bindState(this, i);
+    }
+}
+
+void TrainStateStore::unbind() {
+    for (size_t i = 0; i < _trains.size(); ++i) {
+        _trains[i]->bindState(NULL, 0);
+    }
+    _trains.clear();
+}
+
+void TrainStateStore::endStep(const std::vector<size_t>& slots) {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        _active[slots[i]] = 0.0;
+        _railEnd[slots[i]] = 0;
+    }
+}
+
+void TrainStateStore::prepare(size_t slot, double railLength, double speedLimit,
+                              bool brakeAhead) {
+    _active[slot] = 1.0;
+    _railLength[slot] = railLength;
+    _speedLimit[slot] = speedLimit;
+    _brakeAhead[slot] = brakeAhead ? 1.0 : 0.0;
+}
+
+void TrainStateStore::integrate(size_t begin, size_t end, double stepHours) {
+    end = std::min(end, _trains.size());
+
+#ifdef __SSE2__
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d dt = _mm_set1_pd(stepHours);
+    const __m128d cruise = _mm_set1_pd(CRUISE_FRACTION);
+    const __m128d zone = _mm_set1_pd(BRAKING_ZONE);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d kmh = _mm_set1_pd(3.6);
+
+    for (; begin + 2 <= end; begin += 2) {
+        __m128d active = _mm_cmpgt_pd(_mm_loadu_pd(&_active[begin]), half);
+        if (_mm_movemask_pd(active) == 0) {
+            continue;
+        }
+
+        __m128d v0 = _mm_loadu_pd(&_speed[begin]);
+        __m128d d0 = _mm_loadu_pd(&_distance[begin]);
+        __m128d length = _mm_loadu_pd(&_railLength[begin]);
+        __m128d limit = _mm_loadu_pd(&_speedLimit[begin]);
+        __m128d accel = _mm_loadu_pd(&_accel[begin]);
+        __m128d brake = _mm_loadu_pd(&_brake[begin]);
+        __m128d ahead = _mm_cmpgt_pd(_mm_loadu_pd(&_brakeAhead[begin]), half);
+
+        // Candidate speeds: braking, accelerating (no traction at the limit), holding
+        __m128d braked = _mm_max_pd(zero, _mm_sub_pd(v0, _mm_mul_pd(brake, dt)));
+        __m128d traction = _mm_and_pd(_mm_cmplt_pd(v0, limit), accel);
+        __m128d accelerated = _mm_min_pd(limit, _mm_add_pd(v0, _mm_mul_pd(traction, dt)));
+        __m128d held = _mm_min_pd(limit, v0);
+
+        __m128d below = _mm_cmplt_pd(v0, _mm_mul_pd(limit, cruise));
+        __m128d v1 = _mm_or_pd(_mm_and_pd(below, accelerated), _mm_andnot_pd(below, held));
+
+        // Brake for a train ahead or near the rail end
+        __m128d remaining = _mm_sub_pd(length, d0);
+        __m128d stopping = _mm_div_pd(_mm_mul_pd(v0, v0), _mm_div_pd(_mm_mul_pd(two, brake), kmh));
+        __m128d endZone = _mm_and_pd(_mm_cmplt_pd(remaining, stopping),
+                                     _mm_cmplt_pd(remaining, zone));
+        __m128d braking = _mm_or_pd(ahead, endZone);
+        v1 = _mm_or_pd(_mm_and_pd(braking, braked), _mm_andnot_pd(braking, v1));
+
+        __m128d step = _mm_mul_pd(v1, dt);
+        __m128d d1 = _mm_add_pd(d0, step);
+        __m128d railEnd = _mm_and_pd(active, _mm_cmpge_pd(d1, length));
+        __m128d moved = _mm_andnot_pd(railEnd, active);
+
+        _mm_storeu_pd(&_speed[begin], _mm_or_pd(_mm_and_pd(active, v1),
+                                                _mm_andnot_pd(active, v0)));
+        _mm_storeu_pd(&_distance[begin], _mm_or_pd(_mm_and_pd(moved, d1),
+                                                   _mm_andnot_pd(moved, d0)));
+        _mm_storeu_pd(&_stepDistance[begin], step);
+
+        int activeBits = _mm_movemask_pd(active);
+        int brakingBits = _mm_movemask_pd(braking);
+        int belowBits = _mm_movemask_pd(below);
+        int endBits = _mm_movemask_pd(railEnd);
+        for (int lane = 0; lane < 2; ++lane) {
+            if (!(activeBits & (1 << lane))) {
+                continue;
+            }
+            size_t slot = begin + lane;
+            if (brakingBits & (1 << lane)) {
+                _state[slot] = STATE_BRAKING;
+            } else if (belowBits & (1 << lane)) {
+                _state[slot] = STATE_ACCELERATING;
+            } else {
+                _state[slot] = STATE_MAINTAINING;
+            }
+            _railEnd[slot] = (endBits & (1 << lane)) ? 1 : 0;
+        }
+    }
+#endif
+
+    integrateScalar(begin, end, stepHours);
+}
+
+void TrainStateStore::integrateScalar(size_t begin, size_t end, double stepHours) {
+    for (size_t i = begin; i < end; ++i) {
+        if (_active[i] <= 0.5) {
+            continue;
+        }
+
+        double v0 = _speed[i];
+        double limit = _speedLimit[i];
+        double braked = std::max(0.0, v0 - _brake[i] * stepHours);
+
+        double v1;
+        TrainState state;
+        if (v0 < limit * CRUISE_FRACTION) {
+            double traction = (v0 < limit) ? _accel[i] : 0.0;
+            v1 = std::min(limit, v0 + traction * stepHours);
+            state = STATE_ACCELERATING;
+        } else {
+            v1 = std::min(limit, v0);
+            state = STATE_MAINTAINING;
+        }
+
+        double remaining = _railLength[i] - _distance[i];
+        double stopping = (v0 * v0) / (2.0 * _brake[i] / 3.6);
+        if (_brakeAhead[i] > 0.5 || (remaining < stopping && remaining < BRAKING_ZONE)) {
+            v1 = braked;
+            state = STATE_BRAKING;
+        }
+
+        double step = v1 * stepHours;
+        _speed[i] = v1;
+        _state[i] = state;
+        _stepDistance[i] = step;
+        if (_distance[i] + step >= _railLength[i]) {
+            _railEnd[i] = 1;
+        } else {
+            _distance[i] += step;
+        }
+    }
+}
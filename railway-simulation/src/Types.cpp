@@ -8,3 +8,35 @@ std::string Time::toString() const {
         << "h" << std::setw(2) << minutes;
     return oss.str();
 }
+
+std::string formatClock(Tick tick) {
+    Tick day = tick / TICKS_PER_DAY;
+    Tick ofDay = tick % TICKS_PER_DAY;
+    if (ofDay < 0) {
+        ofDay += TICKS_PER_DAY;
+        day -= 1;
+    }
+    
+    std::ostringstream oss;
+    oss << std::setfill('0') << std::setw(2) << ofDay / TICKS_PER_HOUR
+        << "h" << std::setw(2) << (ofDay % TICKS_PER_HOUR) / TICKS_PER_MINUTE;
+    if (day != 0) {
+        oss << (day > 0 ? "+" : "") << day << "d";
+    }
+    return oss.str();
+}
+
+std::string formatDuration(Tick ticks) {
+    std::ostringstream oss;
+    if (ticks < 0) {
+        oss << "-";
+        ticks = -ticks;
+    }
+    oss << std::setfill('0') << std::setw(2) << ticks / TICKS_PER_HOUR
+        << "h" << std::setw(2) << (ticks % TICKS_PER_HOUR) / TICKS_PER_MINUTE;
+    return oss.str();
+}
+
+bool isTrainState(int value) {
+    return value >= STATE_ACCELERATING && value <= STATE_BRAKING;
+}
@@ -2,176 +2,139 @@
 #include "../incl/InputParser.hpp"
 #include "../incl/OutputWriter.hpp"
 #include "../incl/DijkstraPathfinding.hpp"
+#include "../incl/CachedPathfinding.hpp"
+#include "../incl/MonteCarloRunner.hpp"
+#include <cerrno>
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
 
-void runSimulation(RailwayNetwork* network, std::vector<Train*>& trains) {
+// Upper bound of --threads, far above any core count
+static const unsigned long long MAX_WORKER_THREADS = 1024;
+
+/**
+ * CLI progress: departures, trains stuck where they left, and a line every
+ * 100 steps. Only the running trains are visited: a train departs on the
+ * step it first shows up in the active list.
+ */
+class ProgressReporter : public IStepObserver {
+private:
+    std::vector<bool> _hasStartedMoving;
+    std::vector<Tick> _actualDepartureTime;
+
+public:
+    explicit ProgressReporter(size_t trainCount)
+        : _hasStartedMoving(trainCount, false), _actualDepartureTime(trainCount, 0) {}
+    
+    bool hasStartedMoving(size_t index) const { return _hasStartedMoving[index]; }
+    Tick getActualDepartureTime(size_t index) const { return _actualDepartureTime[index]; }
+    
+    virtual void onStep(const StepView& view) {
+        const std::vector<Train*>& trains = view.getTrains();
+        const std::vector<size_t>& active = view.getActiveTrains();
+        for (size_t k = 0; k < active.size(); ++k) {
+            size_t i = active[k];
+            Train* train = trains[i];
+            
+            if (!_hasStartedMoving[i]) {
+                _hasStartedMoving[i] = true;
+                _actualDepartureTime[i] = train->getCurrentTime();
+                std::cout << "  Train " << train->getName() 
+                          << " started moving at " << formatClock(train->getCurrentTime())
+                          << " (scheduled: " << formatClock(train->getDepartureTime()) << ")"
+                          << std::endl;
+            }
+            
+            // Debug: Check why train is stuck
+            if (view.getIndex() % 50 == 0 && train->getState() == STATE_STOPPED &&
+                train->isAtStation()) {
+                std::cout << "  WARNING: Train " << train->getName() 
+                          << " still stopped at " << formatClock(train->getCurrentTime())
+                          << " (scheduled departure: " << formatClock(train->getDepartureTime()) << ")"
+                          << " State: " << train->getStateString()
+                          << std::endl;
+            }
+        }
+        
+        // Progress indicator
+        if ((view.getIndex() + 1) % 100 == 0) {
+            std::cout << "  Simulation step: " << view.getIndex() + 1
+                      << " | Time: " << formatClock(view.getTime()) << std::endl;
+        }
+    }
+};
+
+void runSimulation(RailwayNetwork* network, std::vector<Train*>& trains,
+                   const std::vector<ScheduledEvent>& events, size_t streamWindow,
+                   size_t workerThreads) {
     SimulationManager* sim = SimulationManager::getInstance();
     
     sim->setNetwork(network);
-    sim->setPathfindingStrategy(new DijkstraPathfinding());
+    sim->setWorkerThreads(workerThreads);
+    CachedPathfinding* routeCache = new CachedPathfinding(new DijkstraPathfinding(network), network);
+    sim->setPathfindingStrategy(routeCache);
     
     // Add all trains
     for (size_t i = 0; i < trains.size(); ++i) {
         sim->addTrain(trains[i]);
     }
     
-    // Create output writers for each train
+    for (size_t i = 0; i < events.size(); ++i) {
+        sim->scheduleEvent(events[i].event, events[i].start, events[i].end);
+    }
+
+    // Trains avoid restricted or closed rails when a faster way exists
+    sim->setRerouting(!events.empty());
+    
+    // Create output writers for each train; they record a snapshot per step
     std::vector<OutputWriter*> writers;
     for (size_t i = 0; i < trains.size(); ++i) {
         OutputWriter* writer = new OutputWriter(trains[i]);
+        writer->setStreaming(streamWindow);
         writers.push_back(writer);
         sim->attach(writer);
+        sim->addStepObserver(writer);
     }
+    ProgressReporter progress(trains.size());
+    sim->addStepObserver(&progress);
     
     std::cout << "\n=== Initializing Simulation ===" << std::endl;
     sim->initialize();
+    // With more threads each one fills its own clone of the cache; the
+    // counts are those of the first
+    std::cout << "Route cache: " << routeCache->getHitCount() << " hits, "
+              << routeCache->getMissCount() << " misses" << std::endl;
     
     std::cout << "=== Running Simulation ===" << std::endl;
-    
-    Time startTime = sim->getCurrentTime();
-    int maxIterations = 5000;
-    int iteration = 0;
-    
-    // Track if trains have started moving
-    std::vector<bool> hasStartedMoving(trains.size(), false);
-    std::vector<Time> actualDepartureTime(trains.size());
-    
-    while (!sim->isComplete() && iteration < maxIterations) {
-        sim->step();
-        
-        // Record snapshots for each train
-        for (size_t i = 0; i < trains.size(); ++i) {
-            Train* train = trains[i];
-            
-            // Check if train should have departed but hasn't moved
-            if (train->getCurrentTime() >= train->getDepartureTime()) {
-                if (!hasStartedMoving[i] && train->getState() != STATE_STOPPED) {
-                    hasStartedMoving[i] = true;
-                    actualDepartureTime[i] = train->getCurrentTime();
-                    std::cout << "  Train " << train->getName() 
-                              << " started moving at " << train->getCurrentTime().toString()
-                              << " (scheduled: " << train->getDepartureTime().toString() << ")"
-                              << std::endl;
-                }
-                
-                // Debug: Check why train is stuck
-                if (!hasStartedMoving[i] && iteration % 50 == 0) {
-                    std::cout << "  WARNING: Train " << train->getName() 
-                              << " still stopped at " << train->getCurrentTime().toString()
-                              << " (scheduled departure: " << train->getDepartureTime().toString() << ")"
-                              << " State: " << train->getStateString()
-                              << std::endl;
-                }
-            }
-            
-            const Position& pos = train->getPosition();
-            
-            // Only record snapshots after departure time
-            if (train->getCurrentTime() >= train->getDepartureTime() && 
-                pos.currentRail != NULL && iteration % 1 == 0) {
-                
-                SimulationSnapshot snapshot;
-                snapshot.time = train->getCurrentTime();
-                snapshot.startNode = pos.lastNode ? pos.lastNode->getName() : "";
-                snapshot.endNode = pos.nextNode ? pos.nextNode->getName() : "";
-                snapshot.distanceRemaining = train->getTotalDistanceToGo();
-                snapshot.action = train->getStateString();
-                snapshot.railLength = pos.currentRail->getLength();
-                snapshot.progressPercent = (pos.distanceOnRail / pos.currentRail->getLength()) * 100.0;
-                
-                // Populate other train positions
-                snapshot.otherTrainPositions.clear();
-                
-                for (size_t j = 0; j < trains.size(); ++j) {
-                    if (i == j) continue;
-                    
-                    Train* otherTrain = trains[j];
-                    
-                    // Check if other train has departed
-                    if (otherTrain->getCurrentTime() < otherTrain->getDepartureTime()) {
-                        continue;
-                    }
-                    
-                    const Position& otherPos = otherTrain->getPosition();
-                    
-                    // Check if other train has a valid current rail
-                    if (otherPos.currentRail == NULL) {
-                        continue;
-                    }
-                    
-                    // Check if on the same rail segment
-                    if (otherPos.currentRail == pos.currentRail &&
-                        otherPos.lastNode == pos.lastNode &&
-                        otherPos.nextNode == pos.nextNode) {
-                        
-                        // Add the other train's position in kilometers
-                        snapshot.otherTrainPositions.push_back(otherPos.distanceOnRail);
-                    }
-                }
-                
-                writers[i]->addSnapshot(snapshot);
-            }
-        }
-        
-        iteration++;
-        
-        // Progress indicator
-        if (iteration % 100 == 0) {
-            std::cout << "  Simulation step: " << iteration 
-                      << " | Time: " << sim->getCurrentTime().toString() << std::endl;
-        }
-    }
+    sim->run();
     
     std::cout << "\n=== Simulation Complete ===" << std::endl;
-    std::cout << "Total iterations: " << iteration << std::endl;
+    std::cout << "Total iterations: " << sim->getStepCount() << std::endl;
     
     // Calculate final times and write outputs with proper day handling
     for (size_t i = 0; i < trains.size(); ++i) {
-        // Get arrival and departure times
-        Time arrivalTime = trains[i]->getCurrentTime();
-        Time departureTime = trains[i]->getDepartureTime();
-        
-        // Convert to minutes for calculation
-        int arrivalMinutes = arrivalTime.toMinutes();
-        int departureMinutes = departureTime.toMinutes();
-        
-        // Handle day rollover (if arrival is next day)
-        // This assumes the train journey is less than 24 hours
-        if (arrivalMinutes < departureMinutes) {
-            arrivalMinutes += 24 * 60; // Add 24 hours for next day
-        }
-        
-        // Calculate travel time in minutes
-        int travelMinutes = arrivalMinutes - departureMinutes;
-        
-        // Convert back to hours and minutes
-        int travelHours = travelMinutes / 60;
-        int travelMins = travelMinutes % 60;
-        
-        // Create proper travel time (handle cases over 24 hours if needed)
-        Time travelTime(travelHours, travelMins);
+        // Absolute ticks: no day rollover to guess. Travel time only
+        // exists for a train that both left and reached its destination
+        Tick arrivalTime = trains[i]->getCurrentTime();
+        Tick departureTime = trains[i]->getDepartureTime();
+        bool completed = progress.hasStartedMoving(i) && trains[i]->hasArrived();
+        Tick travelTime = completed ? arrivalTime - departureTime : 0;
         
         writers[i]->setEstimatedTime(travelTime);
         writers[i]->writeToFile();
         
         std::cout << "\nTrain " << trains[i]->getName() << " Summary:"
-                  << "\n  Scheduled departure: " << departureTime.toString()
-                  << "\n  Actual departure: " << (hasStartedMoving[i] ? 
-                        actualDepartureTime[i].toString() : "Never departed")
-                  << "\n  Arrival: " << arrivalTime.toString();
-        
-        // Show if arrival is next day
-        if (arrivalTime.toMinutes() < departureTime.toMinutes()) {
-            std::cout << " (next day)";
+                  << "\n  Scheduled departure: " << formatClock(departureTime)
+                  << "\n  Actual departure: " << (progress.hasStartedMoving(i) ? 
+                        formatClock(progress.getActualDepartureTime(i)) : "Never departed")
+                  << "\n  Arrival: " << (trains[i]->hasArrived() ?
+                        formatClock(arrivalTime) : "Not arrived");
+        if (completed) {
+            std::cout << "\n  Travel time: " << formatDuration(travelTime)
+                      << " (" << travelTime / TICKS_PER_MINUTE << " minutes)" << std::endl;
+        } else {
+            std::cout << "\n  Travel time: N/A" << std::endl;
         }
-        
-        std::cout << "\n  Travel time: " << travelTime.toString() 
-                  << " (" << travelMinutes << " minutes)" << std::endl;
-                  
-        // Check if train is still at origin
-        const Position& finalPos = trains[i]->getPosition();
     }
     
     // Cleanup
@@ -182,6 +145,48 @@ void runSimulation(RailwayNetwork* network, std::vector<Train*>& trains) {
     SimulationManager::destroyInstance();
 }
 
+void runMonteCarlo(RailwayNetwork* network, std::vector<Train*>& trains,
+                   size_t replications, unsigned long long seed, size_t workerThreads) {
+    std::cout << "\n=== Running " << replications << " Disrupted Replications (seed "
+              << seed << ") ===" << std::endl;
+    
+    MonteCarloRunner runner(*network, trains);
+    runner.setReplications(replications);
+    runner.setSeed(seed);
+    runner.setWorkerThreads(workerThreads);
+    runner.run();
+    
+    const std::vector<DelayDistribution>& results = runner.getResults();
+    for (size_t i = 0; i < results.size(); ++i) {
+        const DelayDistribution& result = results[i];
+        std::cout << "\nTrain " << result.trainName << " arrival delay (minutes):";
+        if (result.delays.empty()) {
+            std::cout << "\n  No replication arrived";
+        } else {
+            std::cout << "\n  Mean: " << result.mean() / TICKS_PER_MINUTE
+                      << "  P50: " << result.percentile(50) / TICKS_PER_MINUTE
+                      << "  P90: " << result.percentile(90) / TICKS_PER_MINUTE
+                      << "  P95: " << result.percentile(95) / TICKS_PER_MINUTE
+                      << "  Max: " << result.delays.back() / TICKS_PER_MINUTE;
+        }
+        std::cout << "\n  Arrived: " << result.delays.size() << "/"
+                  << result.delays.size() + result.notArrived << std::endl;
+    }
+}
+
+/**
+ * Whole decimal number, no sign, no trailing text, within range
+ */
+bool parseUnsigned(const char* text, unsigned long long& value) {
+    if (text == NULL || *text < '0' || *text > '9') {
+        return false;
+    }
+    char* end = NULL;
+    errno = 0;
+    value = std::strtoull(text, &end, 10);
+    return errno == 0 && end != text && *end == '\0';
+}
+
 int main(int argc, char** argv) {
     // srand(time(NULL));
     
@@ -191,12 +196,51 @@ int main(int argc, char** argv) {
         return 0;
     }
     
-    if (argc != 3) {
+    // Trailing "--stream <records>": write result files in windows.
+    // Trailing "--threads <count>": worker threads, 0 = every core
+    unsigned long long streamWindow = 0;
+    unsigned long long workerThreads = 1;
+    bool threadsGiven = false;
+    while (argc >= 5) {
+        std::string option = argv[argc - 2];
+        const char* value = argv[argc - 1];
+        if (option == "--stream") {
+            if (!parseUnsigned(value, streamWindow) || streamWindow == 0) {
+                std::cerr << "ERROR: Invalid stream window: " << value << std::endl;
+                return 1;
+            }
+        } else if (option == "--threads") {
+            if (!parseUnsigned(value, workerThreads) || workerThreads > MAX_WORKER_THREADS) {
+                std::cerr << "ERROR: Invalid number of threads: " << value << std::endl;
+                return 1;
+            }
+            threadsGiven = true;
+        } else {
+            break;
+        }
+        argc -= 2;
+    }
+    
+    bool monteCarlo = (argc == 5 || argc == 6) && std::string(argv[3]) == "--monte-carlo";
+    if (argc != 3 && argc != 4 && !monteCarlo) {
         std::cerr << "ERROR: Invalid number of arguments" << std::endl;
         InputParser::printUsage();
         return 1;
     }
     
+    unsigned long long replications = 0;
+    unsigned long long seed = 1;
+    if (monteCarlo) {
+        if (!parseUnsigned(argv[4], replications) || replications == 0) {
+            std::cerr << "ERROR: Invalid number of runs: " << argv[4] << std::endl;
+            return 1;
+        }
+        if (argc == 6 && !parseUnsigned(argv[5], seed)) {
+            std::cerr << "ERROR: Invalid seed: " << argv[5] << std::endl;
+            return 1;
+        }
+    }
+    
     std::cout << "=== Railway Network Simulation ===" << std::endl;
     std::cout << "Network file: " << argv[1] << std::endl;
     std::cout << "Trains file: " << argv[2] << std::endl << std::endl;
@@ -222,7 +266,20 @@ int main(int argc, char** argv) {
     
     // Run simulation
     try {
-        runSimulation(network, trains);
+        if (monteCarlo) {
+            // The replications use every core unless told otherwise
+            size_t replicaThreads = threadsGiven ? static_cast<size_t>(workerThreads) : 0;
+            runMonteCarlo(network, trains, static_cast<size_t>(replications), seed,
+                          replicaThreads);
+        } else {
+            std::vector<ScheduledEvent> events;
+            if (argc == 4) {
+                std::cout << "\n=== Loading Events ===" << std::endl;
+                events = InputParser::parseEventsFile(argv[3], network, trains);
+            }
+            runSimulation(network, trains, events, static_cast<size_t>(streamWindow),
+                          static_cast<size_t>(workerThreads));
+        }
     } catch (const std::exception& e) {
         std::cerr << "ERROR during simulation: " << e.what() << std::endl;
         